@@ -5,6 +5,8 @@
 #include <cstdlib>
 #include <algorithm>
 #include <string.h>
+#include <mutex>
+#include <sys/stat.h>
 
 #if DEBUG
 #include <ctime>
@@ -31,11 +33,18 @@ extern "C" {
 
 #define CFG_ID "vgmstream" // ID for storing in audacious
 #define MIN_BUFFER_SIZE 576
+#define NEGCACHE_FILENAME "vgmstream-negcache.txt"
+#define NEGCACHE_MAX_ENTRIES 100000
+#define PCMCACHE_MAX_BYTES (64 * 1024 * 1024)
+#define PCMCACHE_MAX_ENTRY_BYTES (8 * 1024 * 1024)
 
 /* global state */
 /*EXPORT*/ VgmstreamPlugin aud_plugin_instance;
 audacious_settings settings;
 VGMSTREAM *vgmstream = NULL; //todo make local?
+VGMSTREAM_NEGCACHE *negcache = NULL; // files that failed to open, so rescans don't probe them again
+std::mutex negcache_mutex; // is_our_file/read_info may be called from many threads
+VGMSTREAM_PCMCACHE *pcmcache = NULL; // decoded samples of short files, so replays skip decoding (play thread only)
 
 /* Audacious will first send the file to a plugin based on this static extension list. If none
  * accepts it'll try again all plugins, ordered by priority, until one accepts the file. Problem is,
@@ -56,6 +65,7 @@ const char *const VgmstreamPlugin::defaults[] = {
     "downmix_channels", "8",
     "exts_unknown_on",  "FALSE",
     "exts_common_on",   "FALSE",
+    "negcache_on",      "TRUE",
     NULL
 };
 
@@ -83,6 +93,8 @@ const PreferencesWidget VgmstreamPlugin::widgets[] = {
     // Audacious 3.6 will only match one plugin so this option has no actual use
     // (ex. a fake .flac only gets to the FLAC plugin and never to vgmstream, even on error)
     //WidgetCheck(N_("Enable common exts"), WidgetBool(settings.exts_common_on)),
+    // disabling also forgets current failures (ex. after adding a .txth for them)
+    WidgetCheck(N_("Skip files that failed to open"), WidgetBool(settings.negcache_on)),
 };
 
 void vgmstream_settings_load() {
@@ -95,6 +107,7 @@ void vgmstream_settings_load() {
     settings.downmix_channels = aud_get_int(CFG_ID, "downmix_channels");
     settings.exts_unknown_on = aud_get_bool(CFG_ID, "exts_unknown_on");
     settings.exts_common_on = aud_get_bool(CFG_ID, "exts_common_on");
+    settings.negcache_on = aud_get_bool(CFG_ID, "negcache_on");
 }
 
 void vgmstream_settings_save() {
@@ -106,6 +119,12 @@ void vgmstream_settings_save() {
     aud_set_int(CFG_ID, "downmix_channels", settings.downmix_channels);
     aud_set_bool(CFG_ID, "exts_unknown_on", settings.exts_unknown_on);
     aud_set_bool(CFG_ID, "exts_common_on", settings.exts_common_on);
+    aud_set_bool(CFG_ID, "negcache_on", settings.negcache_on);
+
+    if (!settings.negcache_on) {
+        std::lock_guard<std::mutex> lock(negcache_mutex);
+        vgmstream_negcache_clear(negcache);
+    }
 }
 
 const PluginPreferences VgmstreamPlugin::prefs = {
@@ -120,7 +139,28 @@ bool VgmstreamPlugin::is_our_file(const char *filename, VFSFile &file) {
 
     cfg.accept_unknown = settings.exts_unknown_on;
     cfg.accept_common = settings.exts_common_on;
-    return vgmstream_ctx_is_valid(filename, &cfg) > 0 ? true : false;
+
+    // negcache only works with local files (checks if they changed), non-file URIs are always probed
+    StringBuf path = uri_to_filename(filename);
+    if (!path || !settings.negcache_on)
+        return vgmstream_ctx_is_valid(filename, &cfg) > 0 ? true : false;
+
+    std::lock_guard<std::mutex> lock(negcache_mutex);
+    cfg.negcache = negcache;
+    return vgmstream_ctx_is_valid(path, &cfg) > 0 ? true : false;
+}
+
+// remember files that vgmstream can't open, to reject them in is_our_file next time
+static void negcache_add_file(const char * filename) {
+    if (!settings.negcache_on)
+        return;
+
+    StringBuf path = uri_to_filename(filename);
+    if (!path)
+        return;
+
+    std::lock_guard<std::mutex> lock(negcache_mutex);
+    vgmstream_negcache_add(negcache, path);
 }
 
 // called on startup (main thread)
@@ -129,6 +169,12 @@ bool VgmstreamPlugin::init() {
 
     vgmstream_settings_load();
 
+    // a missing/bad cache file just starts empty, and without negcache files are always probed
+    StringBuf negcache_filename = filename_build({aud_get_path(AudPath::UserDir), NEGCACHE_FILENAME});
+    negcache = vgmstream_negcache_init(negcache_filename, VERSION, NEGCACHE_MAX_ENTRIES);
+
+    pcmcache = vgmstream_pcmcache_init(PCMCACHE_MAX_BYTES, PCMCACHE_MAX_ENTRY_BYTES);
+
     return true;
 }
 
@@ -137,6 +183,13 @@ void VgmstreamPlugin::cleanup() {
     AUDINFO("plugin end\n");
 
     vgmstream_settings_save();
+
+    vgmstream_negcache_save(negcache);
+    vgmstream_negcache_close(negcache);
+    negcache = NULL;
+
+    vgmstream_pcmcache_close(pcmcache);
+    pcmcache = NULL;
 }
 
 #if 0
@@ -169,10 +222,12 @@ static bool read_info(const char * filename, Tuple & tuple) {
 
     STREAMFILE *streamfile = open_vfs(filename);
     if (!streamfile) return false;
+    streamfile->info_only = 1; /* playlist length only, play() reopens for exact values */
 
     VGMSTREAM *infostream = init_vgmstream_from_STREAMFILE(streamfile);
     if (!infostream) {
         close_streamfile(streamfile);
+        negcache_add_file(filename);
         return false;
     }
 
@@ -271,6 +326,38 @@ static void seek_helper(int seek_value, int &current_sample_pos, int input_chann
     }
 }
 
+// internal helper, makes the pcmcache key: settings that alter decoded samples (loops and fades
+// are done over the cached samples) plus file size/time to notice changes; false if not cacheable
+static bool get_pcmcache_config(const char *filename, char *config, size_t config_size) {
+    if (!pcmcache)
+        return false;
+
+    StringBuf path = uri_to_filename(filename);
+    struct stat st;
+    if (!path || stat(path, &st) != 0)
+        return false;
+
+    snprintf(config, config_size, "downmix=%i size=%lld time=%lld",
+            settings.downmix_channels, (long long)st.st_size, (long long)st.st_mtime);
+    return true;
+}
+
+// same as get_vgmstream_play_samples, for cached streams
+static int get_pcmcache_play_samples(const vgmstream_pcmcache_info &info) {
+    if (!info.loop_flag)
+        return info.num_samples;
+
+    if (info.loop_target == settings.loop_count) {
+        return info.loop_start_sample
+            + (info.loop_end_sample - info.loop_start_sample) * settings.loop_count
+            + (info.num_samples - info.loop_end_sample);
+    }
+
+    return info.loop_start_sample
+        + (info.loop_end_sample - info.loop_start_sample) * settings.loop_count
+        + (settings.fade_delay + settings.fade_length) * info.sample_rate;
+}
+
 // called on play (play thread)
 bool VgmstreamPlugin::play(const char *filename, VFSFile &file) {
     AUDINFO("play file=%s\n", filename);
@@ -278,65 +365,108 @@ bool VgmstreamPlugin::play(const char *filename, VFSFile &file) {
     // just in case
     if (vgmstream)
         close_vgmstream(vgmstream);
+    vgmstream = NULL;
 
-    STREAMFILE *streamfile = open_vfs(filename);
-    if (!streamfile) {
-        AUDERR("failed opening file %s\n", filename);
-        return false;
+    // short files played before are rendered from the pcmcache, without opening them
+    char cache_config[256];
+    bool use_pcmcache = get_pcmcache_config(filename, cache_config, sizeof(cache_config));
+    VGMSTREAM_PCMCACHE_ENTRY *entry = NULL;
+    if (use_pcmcache)
+        entry = vgmstream_pcmcache_get(pcmcache, filename, 0, cache_config);
+
+    vgmstream_pcmcache_info info;
+    int input_channels, output_channels;
+    int stream_samples_amount;
+
+    if (entry) {
+        AUDINFO("playing %s from cache\n", filename);
+        // bitrate of the original file isn't known here (playlist has it from read_info)
+        vgmstream_pcmcache_get_info(entry, &info);
+        input_channels = output_channels = info.channels;
+        stream_samples_amount = get_pcmcache_play_samples(info);
     }
+    else {
+        STREAMFILE *streamfile = open_vfs(filename);
+        if (!streamfile) {
+            AUDERR("failed opening file %s\n", filename);
+            return false;
+        }
 
-    vgmstream = init_vgmstream_from_STREAMFILE(streamfile);
-    close_streamfile(streamfile);
+        vgmstream = init_vgmstream_from_STREAMFILE(streamfile);
+        close_streamfile(streamfile);
 
-    if (!vgmstream) {
-        AUDINFO("filename %s is not a valid format\n", filename);
-        close_vgmstream(vgmstream);
-        vgmstream = NULL;
-        return false;
-    }
+        if (!vgmstream) {
+            AUDINFO("filename %s is not a valid format\n", filename);
+            close_vgmstream(vgmstream);
+            vgmstream = NULL;
+            return false;
+        }
+
+        int bitrate = get_vgmstream_average_bitrate(vgmstream);
+        set_stream_bitrate(bitrate);
 
-    int bitrate = get_vgmstream_average_bitrate(vgmstream);
-    set_stream_bitrate(bitrate);
+        //todo apply config
 
-    //todo apply config
+        input_channels = vgmstream->channels;
+        output_channels = vgmstream->channels;
+        /* enable after all config but before outbuf */
+        vgmstream_mixing_autodownmix(vgmstream, settings.downmix_channels);
+        vgmstream_mixing_enable(vgmstream, MIN_BUFFER_SIZE, &input_channels, &output_channels);
 
-    int input_channels = vgmstream->channels;
-    int output_channels = vgmstream->channels;
-    /* enable after all config but before outbuf */
-    vgmstream_mixing_autodownmix(vgmstream, settings.downmix_channels);
-    vgmstream_mixing_enable(vgmstream, MIN_BUFFER_SIZE, &input_channels, &output_channels);
+        stream_samples_amount = get_vgmstream_play_samples(
+                settings.loop_count, settings.fade_length,
+                settings.fade_delay, vgmstream);
+
+        // decodes the whole file if short enough (vgmstream is reset after), not needed once cached
+        if (use_pcmcache)
+            entry = vgmstream_pcmcache_add(pcmcache, filename, 0, cache_config, vgmstream, MIN_BUFFER_SIZE);
+        if (entry) {
+            vgmstream_pcmcache_get_info(entry, &info);
+            close_vgmstream(vgmstream);
+            vgmstream = NULL;
+        }
+        else {
+            info.channels = output_channels;
+            info.sample_rate = vgmstream->sample_rate;
+            info.loop_flag = vgmstream->loop_flag;
+        }
+    }
 
     //FMT_S8 / FMT_S16_NE / FMT_S24_NE / FMT_S32_NE / FMT_FLOAT
-    open_audio(FMT_S16_LE, vgmstream->sample_rate, output_channels);
+    open_audio(FMT_S16_LE, info.sample_rate, output_channels);
 
     // play
     short buffer[MIN_BUFFER_SIZE * input_channels];
     int max_buffer_samples = MIN_BUFFER_SIZE;
-    int stream_samples_amount = get_vgmstream_play_samples(
-            settings.loop_count, settings.fade_length,
-            settings.fade_delay, vgmstream);
-    int fade_samples = settings.fade_length * vgmstream->sample_rate;
+    int fade_samples = settings.fade_length * info.sample_rate;
     int current_sample_pos = 0;
 
     while (!check_stop()) {
         int toget = max_buffer_samples;
 
-        // handle seek request
+        // handle seek request (cached samples can be copied from anywhere)
         int seek_value = check_seek();
-        if (seek_value >= 0)
-            seek_helper(seek_value, current_sample_pos, input_channels);
+        if (seek_value >= 0) {
+            if (entry)
+                current_sample_pos = (long long)seek_value * info.sample_rate / 1000L;
+            else
+                seek_helper(seek_value, current_sample_pos, input_channels);
+        }
 
         // check stream finished
-        if (!settings.loop_forever || !vgmstream->loop_flag) {
+        if (!settings.loop_forever || !info.loop_flag) {
             if (current_sample_pos >= stream_samples_amount)
                 break;
             if (current_sample_pos + toget > stream_samples_amount)
                 toget = stream_samples_amount - current_sample_pos;
         }
 
-        render_vgmstream(buffer, toget, vgmstream);
+        if (entry)
+            vgmstream_pcmcache_render(entry, buffer, toget, current_sample_pos);
+        else
+            render_vgmstream(buffer, toget, vgmstream);
 
-        if (vgmstream->loop_flag && fade_samples > 0 &&
+        if (info.loop_flag && fade_samples > 0 &&
                 !settings.loop_forever) {
             int samples_into_fade =
                     current_sample_pos - (stream_samples_amount - fade_samples);
@@ -358,6 +488,7 @@ bool VgmstreamPlugin::play(const char *filename, VFSFile &file) {
 
     AUDINFO("play finished\n");
 
+    vgmstream_pcmcache_release(entry);
     close_vgmstream(vgmstream);
     vgmstream = NULL;
     return true;
@@ -51,6 +51,7 @@ typedef struct {
     int downmix_channels;
     bool exts_unknown_on;
     bool exts_common_on;
+    bool negcache_on;
 } audacious_settings;
 
 extern audacious_settings settings;
@@ -15,6 +15,7 @@ typedef struct {
 } VFS_STREAMFILE;
 
 static STREAMFILE *open_vfs_by_VFSFILE(VFSFile *file, const char *path);
+static STREAMFILE *open_vfs_unbuffered(const char *path);
 
 static size_t read_vfs(VFS_STREAMFILE *streamfile, uint8_t *dest, off_t offset, size_t length) {
     size_t bytes_read;
@@ -57,7 +58,7 @@ static STREAMFILE *open_vfs_impl(VFS_STREAMFILE *streamfile, const char *const f
     if (!filename)
         return NULL;
 
-    return open_vfs(filename);
+    return open_vfs_unbuffered(filename);
 }
 
 STREAMFILE *open_vfs_by_VFSFILE(VFSFile *file, const char *path) {
@@ -93,7 +94,7 @@ STREAMFILE *open_vfs_by_VFSFILE(VFSFile *file, const char *path) {
     return &streamfile->sf;
 }
 
-STREAMFILE *open_vfs(const char *path) {
+static STREAMFILE *open_vfs_unbuffered(const char *path) {
     VFSFile *vfsFile = new VFSFile(path, "rb");
     if (!vfsFile || !*vfsFile) {
         delete vfsFile;
@@ -102,3 +103,9 @@ STREAMFILE *open_vfs(const char *path) {
 
     return open_vfs_by_VFSFILE(vfsFile, path);
 }
+
+STREAMFILE *open_vfs(const char *path) {
+    // VFS reads go straight to the (maybe remote) file, so add a cache that adapts to
+    // header parsing and per-channel streaming (its reopens wrap open_vfs_impl's results)
+    return open_readahead_streamfile_f(open_vfs_unbuffered(path), 0, 0);
+}
@@ -0,0 +1,40 @@
+# Resampler test: converts a generated 192 kHz stream to much lower rates (big downsampling
+# ratios), checking the CLI finishes and writes the expected number of samples.
+# usage: cmake -DCLI=<vgmstream_cli path> -DWORK_DIR=<temp dir> -P test_resample.cmake
+
+if(NOT CLI OR NOT WORK_DIR)
+	message(FATAL_ERROR "CLI and WORK_DIR must be defined")
+endif()
+
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+# 3 seconds of 2ch PCM8 at 192 kHz (any bytes will do as data)
+string(REPEAT "0123456789abcdefghijklmnopqrstuvwxyz" 32000 TEST_DATA)
+file(WRITE ${WORK_DIR}/resample.bin "${TEST_DATA}")
+file(WRITE ${WORK_DIR}/resample.bin.txth
+	"codec = PCM8\n"
+	"channels = 2\n"
+	"interleave = 1\n"
+	"sample_rate = 192000\n"
+	"start_offset = 0\n"
+	"num_samples = data_size\n")
+
+foreach(RATE 1000 2000 8000 44100)
+	set(OUTPUT ${WORK_DIR}/resample_${RATE}.wav)
+	file(REMOVE ${OUTPUT})
+
+	execute_process(
+		COMMAND ${CLI} -R ${RATE} -o ${OUTPUT} ${WORK_DIR}/resample.bin
+		RESULT_VARIABLE RESULT
+		OUTPUT_QUIET)
+	if(NOT RESULT EQUAL 0)
+		message(FATAL_ERROR "resampling to ${RATE} Hz failed: ${RESULT}")
+	endif()
+
+	# 16-bit stereo samples plus the 0x2c WAV header
+	math(EXPR EXPECTED_SIZE "3 * ${RATE} * 2 * 2 + 44")
+	file(SIZE ${OUTPUT} OUTPUT_SIZE)
+	if(NOT OUTPUT_SIZE EQUAL EXPECTED_SIZE)
+		message(FATAL_ERROR "resampling to ${RATE} Hz wrote ${OUTPUT_SIZE} bytes, expected ${EXPECTED_SIZE}")
+	endif()
+endforeach()
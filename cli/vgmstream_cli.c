@@ -9,6 +9,9 @@
 #else
 #include <unistd.h>
 #endif
+#ifdef STDIO_USE_PREAD
+#include <pthread.h>
+#endif
 
 #ifndef STDOUT_FILENO
 #define STDOUT_FILENO 1
@@ -24,6 +27,9 @@
 /* low values are ok as there is very little performance difference, but higher
  * may improve write I/O in some systems as this*channels doubles as output buffer */
 #define SAMPLE_BUFFER_SIZE  32768
+#define RESAMPLE_QUALITY  3     /* offline, so best */
+#define MAX_OPEN_FILES  256     /* for huge playlists (closed files are reopened as needed) */
+#define MAX_THREADS  64
 
 /* getopt globals (the horror...) */
 extern char * optarg;
@@ -48,6 +54,8 @@ static void usage(const char * name, int is_full) {
             "    -m: print metadata only, don't decode\n"
             "    -L: append a smpl chunk and create a looping wav\n"
             "    -2 N: only output the Nth (first is 0) set of stereo channels\n"
+            "    -R N: resample output to N Hz\n"
+            "    -j N: decode with N threads if possible (long PCM/ADPCM streams without loops, not in Windows)\n"
             "    -p: output to stdout (for piping into another program)\n"
             "    -P: output to stdout even if stdout is a terminal\n"
             "    -c: loop forever (continuously) to stdout\n"
@@ -62,6 +70,7 @@ static void usage(const char * name, int is_full) {
                 "    -k N: seeks to N samples before decoding (for seek testing)\n"
                 "    -t file: print tags found in file (for tag testing)\n"
                 "    -O: decode but don't write to file (for performance testing)\n"
+                "    -T: print time spent per stage (for performance testing, needs a VGM_PROFILING build)\n"
                 );
     }
 }
@@ -91,6 +100,9 @@ typedef struct {
     double fade_delay;
     int ignore_fade;
     int seek_samples;
+    int resample_rate;
+    int threads;
+    int print_profile;
 
     /* not quite config but eh */
     int lwav_loop_start;
@@ -110,7 +122,7 @@ static int parse_config(cli_config *cfg, int argc, char ** argv) {
     opterr = 0;
 
     /* read config */
-    while ((opt = getopt(argc, argv, "o:l:f:d:ipPcmxeLEFrgb2:s:t:k:hO")) != -1) {
+    while ((opt = getopt(argc, argv, "o:l:f:d:ipPcmxeLEFrgb2:s:t:k:hOR:j:T")) != -1) {
         switch (opt) {
             case 'o':
                 cfg->outfilename = optarg;
@@ -176,9 +188,18 @@ static int parse_config(cli_config *cfg, int argc, char ** argv) {
             case 'k':
                 cfg->seek_samples = atoi(optarg);
                 break;
+            case 'R':
+                cfg->resample_rate = atoi(optarg);
+                break;
             case 'O':
                 cfg->decode_only = 1;
                 break;
+            case 'j':
+                cfg->threads = atoi(optarg);
+                break;
+            case 'T':
+                cfg->print_profile = 1;
+                break;
             case 'h':
                 usage(argv[0], 1);
                 goto fail;
@@ -229,6 +250,13 @@ static int validate_config(cli_config *cfg) {
         fprintf(stderr,"either -p or -o, make up your mind\n");
         goto fail;
     }
+#ifndef STDIO_USE_PREAD
+    /* ranges reopen files through duplicated handles, that without pread share the read position */
+    if (cfg->threads > 1) {
+        fprintf(stderr,"-j is not supported in this platform\n");
+        goto fail;
+    }
+#endif
 
     return 1;
 fail:
@@ -352,9 +380,30 @@ void apply_fade(sample_t * buf, VGMSTREAM * vgmstream, int to_get, int i, int le
     }
 }
 
+/* writes rendered samples as PC endian; a stereo pair is moved to the start of the buffer in place,
+ * so the whole buffer is always a single big fwrite (buf is modified) */
+static void write_samples(FILE * outfile, sample_t * buf, int samples, int channels, int only_stereo) {
+    if (only_stereo != -1) {
+        int j;
+        for (j = 0; j < samples; j++) {
+            sample_t l = buf[j*channels + (only_stereo*2) + 0];
+            sample_t r = buf[j*channels + (only_stereo*2) + 1];
+            buf[j*2 + 0] = l;
+            buf[j*2 + 1] = r;
+        }
+        channels = 2;
+    }
+
+    swap_samples_le(buf, channels * samples); /* write PC endian */
+    fwrite(buf, sizeof(sample_t), samples * channels, outfile);
+}
+
 void apply_seek(sample_t * buf, VGMSTREAM * vgmstream, int len_samples) {
     int i;
 
+    /* jumps to the loop when possible, rest is decoded and discarded */
+    len_samples = seek_vgmstream(vgmstream, len_samples);
+
     for (i = 0; i < len_samples; i += SAMPLE_BUFFER_SIZE) {
         int to_get = SAMPLE_BUFFER_SIZE;
         if (i + SAMPLE_BUFFER_SIZE > len_samples)
@@ -366,6 +415,228 @@ void apply_seek(sample_t * buf, VGMSTREAM * vgmstream, int len_samples) {
 
 /* ************************************************************ */
 
+#ifdef STDIO_USE_PREAD
+/* Long streams that can be split (see vgmstream_open_range) are decoded in ranges, each thread
+ * with its own copy of the vgmstream writing to its part of the output file. */
+typedef struct {
+    VGMSTREAM* vgmstream;   /* range copy */
+    FILE* outfile;          /* own handle at the range's position, NULL if not writing */
+    int32_t samples;
+    int input_channels;
+    int channels;
+    int only_stereo;
+    int ok;
+} cli_range;
+
+static void render_range(cli_range* range) {
+    sample_t* buf = NULL;
+    int32_t i;
+
+    buf = malloc(SAMPLE_BUFFER_SIZE * sizeof(sample_t) * range->input_channels);
+    if (!buf) return;
+
+    for (i = 0; i < range->samples; i += SAMPLE_BUFFER_SIZE) {
+        int to_get = SAMPLE_BUFFER_SIZE;
+        if (i + SAMPLE_BUFFER_SIZE > range->samples)
+            to_get = range->samples - i;
+
+        render_vgmstream(buf, to_get, range->vgmstream);
+
+        if (range->outfile) {
+            write_samples(range->outfile, buf, to_get, range->channels, range->only_stereo);
+        }
+    }
+
+    free(buf);
+    range->ok = 1;
+}
+
+static void* render_range_thread(void* arg) {
+    render_range(arg);
+    return NULL;
+}
+
+static int seek_output(FILE* outfile, int64_t offset) {
+    /* in steps as fseek's long may be 32-bit */
+    if (fseek(outfile, 0, SEEK_SET) != 0)
+        return 0;
+    while (offset > 0) {
+        long step = offset > 0x40000000 ? 0x40000000 : (long)offset;
+        if (fseek(outfile, step, SEEK_CUR) != 0)
+            return 0;
+        offset -= step;
+    }
+    return 1;
+}
+
+static int is_parallel_render(VGMSTREAM* vgmstream, cli_config* cfg, int32_t len_samples) {
+    int32_t alignment;
+
+    if (cfg->threads <= 1 || cfg->play_sdtout || cfg->play_forever || cfg->seek_samples)
+        return 0;
+    /* profiling counters aren't thread-safe */
+    if (cfg->print_profile)
+        return 0;
+    /* loops are decoded in order, and length must be the stream's */
+    if (vgmstream->loop_flag || len_samples != vgmstream->num_samples)
+        return 0;
+    /* not worth it for short streams */
+    if (len_samples < SAMPLE_BUFFER_SIZE * 2)
+        return 0;
+
+    alignment = vgmstream_get_range_alignment(vgmstream);
+    return alignment > 0 && alignment < len_samples;
+}
+
+static int render_parallel(VGMSTREAM* vgmstream, cli_config* cfg, FILE* outfile, int32_t len_samples) {
+    cli_range ranges[MAX_THREADS];
+    pthread_t handles[MAX_THREADS];
+    int is_started[MAX_THREADS];
+    int i, threads, range_count = 0, ok = 0;
+    int32_t alignment, range_samples;
+    int64_t data_offset = 0;
+
+
+    threads = cfg->threads > MAX_THREADS ? MAX_THREADS : cfg->threads;
+    alignment = vgmstream_get_range_alignment(vgmstream);
+    range_samples = (len_samples + threads - 1) / threads;
+    range_samples = (range_samples + alignment - 1) / alignment * alignment;
+
+    memset(ranges, 0, sizeof(ranges));
+    memset(is_started, 0, sizeof(is_started));
+
+    if (outfile) {
+        fflush(outfile);
+        data_offset = ftell(outfile);
+    }
+
+    for (i = 0; i < threads; i++) {
+        cli_range* range = &ranges[i];
+        int32_t start = i * range_samples;
+        int channels_write;
+
+        if (start >= len_samples)
+            break;
+        range_count++;
+
+        range->samples = len_samples - start < range_samples ? len_samples - start : range_samples;
+        range->only_stereo = cfg->only_stereo;
+        range->vgmstream = vgmstream_open_range(vgmstream, start);
+        if (!range->vgmstream) goto fail;
+
+        vgmstream_mixing_enable(range->vgmstream, SAMPLE_BUFFER_SIZE, &range->input_channels, &range->channels);
+
+        if (outfile) {
+            channels_write = (cfg->only_stereo != -1) ? 2 : range->channels;
+            range->outfile = fopen(cfg->outfilename, "r+b");
+            if (!range->outfile) goto fail;
+            if (!seek_output(range->outfile, data_offset + (int64_t)start * channels_write * sizeof(sample_t)))
+                goto fail;
+        }
+    }
+
+    /* ranges that can't get a thread are rendered here */
+    for (i = 0; i < range_count; i++) {
+        is_started[i] = (pthread_create(&handles[i], NULL, render_range_thread, &ranges[i]) == 0);
+        if (!is_started[i])
+            render_range(&ranges[i]);
+    }
+
+    ok = 1;
+    for (i = 0; i < range_count; i++) {
+        if (is_started[i]) {
+            pthread_join(handles[i], NULL);
+        }
+        if (!ranges[i].ok)
+            ok = 0;
+    }
+
+fail:
+    for (i = 0; i < range_count; i++) {
+        if (ranges[i].outfile)
+            fclose(ranges[i].outfile);
+        close_vgmstream(ranges[i].vgmstream);
+    }
+    return ok;
+}
+#endif
+
+/* ************************************************************ */
+
+#define PROFILE_TOP_INITS  10
+
+static void print_profile_counter(const char* name, vgmstream_profile_counter* counter, const char* count_name) {
+    if (counter->calls == 0)
+        return;
+    /* counters printed as doubles as int64 printf formats aren't portable */
+    fprintf(stderr, "%-32s %10.0f calls %10.3f ms", name, (double)counter->calls, counter->time / 1000000.0);
+    if (count_name)
+        fprintf(stderr, " %12.0f %s", (double)counter->count, count_name);
+    fprintf(stderr, "\n");
+}
+
+static void print_profile(void) {
+    vgmstream_profile* profile = NULL;
+    int top[PROFILE_TOP_INITS];
+    int top_count = 0;
+    int i, j;
+    char name[64];
+
+    profile = malloc(sizeof(vgmstream_profile));
+    if (!profile) return;
+    vgmstream_profile_get(profile);
+
+    if (!profile->enabled) {
+        fprintf(stderr, "no profiling info (library compiled without VGM_PROFILING)\n");
+        free(profile);
+        return;
+    }
+
+    fprintf(stderr, "profile:\n");
+    print_profile_counter("detection", &profile->detection, "not recognized");
+
+    /* slowest init functions, by position in the init list */
+    for (i = 0; i < profile->init_functions_count; i++) {
+        if (profile->init_functions[i].calls == 0)
+            continue;
+        for (j = top_count; j > 0 && profile->init_functions[top[j-1]].time < profile->init_functions[i].time; j--) {
+            if (j < PROFILE_TOP_INITS)
+                top[j] = top[j-1];
+        }
+        if (j < PROFILE_TOP_INITS) {
+            top[j] = i;
+            if (top_count < PROFILE_TOP_INITS)
+                top_count++;
+        }
+    }
+    for (i = 0; i < top_count; i++) {
+        snprintf(name, sizeof(name), "  init function #%i", top[i]);
+        print_profile_counter(name, &profile->init_functions[top[i]], "rejected");
+    }
+
+    print_profile_counter("open stream", &profile->open_stream, NULL);
+
+    for (i = 0; i < VGMSTREAM_PROFILE_MAX_CODINGS; i++) {
+        const char* coding_name = get_vgmstream_coding_name(i);
+        snprintf(name, sizeof(name), "decode %s", coding_name ? coding_name : "?");
+        print_profile_counter(name, &profile->decode[i], "samples");
+    }
+    for (i = 0; i < VGMSTREAM_PROFILE_MAX_LAYOUTS; i++) {
+        const char* layout_name = get_vgmstream_layout_name(i);
+        snprintf(name, sizeof(name), "render %s", layout_name ? layout_name : "?");
+        print_profile_counter(name, &profile->render[i], "samples");
+    }
+    print_profile_counter("mixing", &profile->mixing, "samples");
+    print_profile_counter("resampling", &profile->resampling, "samples");
+
+    print_profile_counter("stdio reads", &profile->stdio_reads, "bytes");
+    print_profile_counter("stdio buffer misses", &profile->stdio_misses, "bytes");
+    fprintf(stderr, "stdio streamfiles opened: %.0f (%.0f buffer bytes)\n", (double)profile->stdio_opens.calls, (double)profile->stdio_opens.count);
+    fprintf(stderr, "vgmstreams allocated: %.0f (%.0f bytes)\n", (double)profile->allocs.calls, (double)profile->allocs.count);
+
+    free(profile);
+}
+
 int main(int argc, char ** argv) {
     VGMSTREAM * vgmstream = NULL;
     FILE * outfile = NULL;
@@ -375,7 +646,8 @@ int main(int argc, char ** argv) {
     int channels, input_channels;
     int32_t len_samples;
     int32_t fade_samples;
-    int i, j;
+    int32_t sample_rate, lwav_loop_start, lwav_loop_end;
+    int i;
 
     cli_config cfg = {0};
     int res;
@@ -421,6 +693,9 @@ int main(int argc, char ** argv) {
         }
 
         streamFile->stream_index = cfg.stream_index;
+        /* files in a handle pool can't be read from threads */
+        if (cfg.threads <= 1)
+            set_stdio_streamfile_limits(streamFile, MAX_OPEN_FILES, 0);
         vgmstream = init_vgmstream_from_STREAMFILE(streamFile);
         close_streamfile(streamFile);
 
@@ -438,8 +713,20 @@ int main(int argc, char ** argv) {
     input_channels = vgmstream->channels;
 
     /* enable after config but before outbuf */
+    if (cfg.resample_rate > 0)
+        vgmstream_mixing_resample(vgmstream, cfg.resample_rate, RESAMPLE_QUALITY);
     vgmstream_mixing_enable(vgmstream, SAMPLE_BUFFER_SIZE, &input_channels, &channels);
 
+    /* values below are at the output rate */
+    sample_rate = cfg.resample_rate > 0 ? cfg.resample_rate : vgmstream->sample_rate;
+    lwav_loop_start = vgmstream_mixing_resampled_samples(vgmstream, cfg.lwav_loop_start);
+    lwav_loop_end = vgmstream_mixing_resampled_samples(vgmstream, cfg.lwav_loop_end);
+
+    if (cfg.only_stereo != -1 && (cfg.only_stereo < 0 || cfg.only_stereo*2 + 1 >= channels)) {
+        fprintf(stderr,"stereo set %i not found (%i channels)\n", cfg.only_stereo, channels);
+        goto fail;
+    }
+
     if (cfg.play_forever && (!vgmstream->loop_flag || vgmstream->loop_target > 0)) {
         fprintf(stderr,"I could play a nonlooped track forever, but it wouldn't end well.");
         goto fail;
@@ -510,7 +797,8 @@ int main(int argc, char ** argv) {
 
     /* get final play config */
     len_samples = get_vgmstream_play_samples(cfg.loop_count,cfg.fade_time,cfg.fade_delay,vgmstream);
-    fade_samples = (int32_t)(cfg.fade_time < 0 ? 0 : cfg.fade_time * vgmstream->sample_rate);
+    len_samples = vgmstream_mixing_resampled_samples(vgmstream, len_samples);
+    fade_samples = (int32_t)(cfg.fade_time < 0 ? 0 : cfg.fade_time * sample_rate);
 
     if (cfg.seek_samples >= len_samples)
         cfg.seek_samples = 0;
@@ -519,7 +807,7 @@ int main(int argc, char ** argv) {
     if (!cfg.play_sdtout && !cfg.print_adxencd && !cfg.print_oggenc && !cfg.print_batchvar) {
         double time_mm, time_ss, seconds;
 
-        seconds = (double)len_samples / vgmstream->sample_rate;
+        seconds = (double)len_samples / sample_rate;
         time_mm = (int)(seconds / 60.0);
         time_ss = seconds - time_mm * 60.0f;
         printf("samples to play: %d (%1.0f:%06.3f seconds)\n", len_samples, time_mm, time_ss);
@@ -541,8 +829,8 @@ int main(int argc, char ** argv) {
         size_t bytes_done;
 
         bytes_done = make_wav_header(wav_buf,0x100,
-                len_samples, vgmstream->sample_rate, channels_write,
-                cfg.write_lwav, cfg.lwav_loop_start, cfg.lwav_loop_end);
+                len_samples, sample_rate, channels_write,
+                cfg.write_lwav, lwav_loop_start, lwav_loop_end);
 
         fwrite(wav_buf,sizeof(uint8_t),bytes_done,outfile);
     }
@@ -554,37 +842,34 @@ int main(int argc, char ** argv) {
 
         render_vgmstream(buf, to_get, vgmstream);
 
-        swap_samples_le(buf, channels * to_get); /* write PC endian */
-        if (cfg.only_stereo != -1) {
-            for (j = 0; j < to_get; j++) {
-                fwrite(buf + j*channels + (cfg.only_stereo*2), sizeof(sample_t), 2, outfile);
-            }
-        } else {
-            fwrite(buf, sizeof(sample_t) * channels, to_get, outfile);
-        }
+        write_samples(outfile, buf, to_get, channels, cfg.only_stereo);
     }
 
 
-    apply_seek(buf, vgmstream, cfg.seek_samples);
+#ifdef STDIO_USE_PREAD
+    if (is_parallel_render(vgmstream, &cfg, len_samples)) {
+        if (!render_parallel(vgmstream, &cfg, cfg.decode_only ? NULL : outfile, len_samples)) {
+            fprintf(stderr,"failed decoding in parallel\n");
+            goto fail;
+        }
+    }
+    else
+#endif
+    {
+        apply_seek(buf, vgmstream, cfg.seek_samples);
 
-    /* decode */
-    for (i = 0; i < len_samples; i += SAMPLE_BUFFER_SIZE) {
-        int to_get = SAMPLE_BUFFER_SIZE;
-        if (i + SAMPLE_BUFFER_SIZE > len_samples)
-            to_get = len_samples - i;
+        /* decode */
+        for (i = 0; i < len_samples; i += SAMPLE_BUFFER_SIZE) {
+            int to_get = SAMPLE_BUFFER_SIZE;
+            if (i + SAMPLE_BUFFER_SIZE > len_samples)
+                to_get = len_samples - i;
 
-        render_vgmstream(buf, to_get, vgmstream);
+            render_vgmstream(buf, to_get, vgmstream);
 
-        apply_fade(buf, vgmstream, to_get, i, len_samples, fade_samples, channels);
+            apply_fade(buf, vgmstream, to_get, i, len_samples, fade_samples, channels);
 
-        if (!cfg.decode_only) {
-            swap_samples_le(buf, channels * to_get); /* write PC endian */
-            if (cfg.only_stereo != -1) {
-                for (j = 0; j < to_get; j++) {
-                    fwrite(buf + j*channels + (cfg.only_stereo*2), sizeof(sample_t), 2, outfile);
-                }
-            } else {
-                fwrite(buf, sizeof(sample_t), to_get * channels, outfile);
+            if (!cfg.decode_only) {
+                write_samples(outfile, buf, to_get, channels, cfg.only_stereo);
             }
         }
     }
@@ -621,8 +906,8 @@ int main(int argc, char ** argv) {
             size_t bytes_done;
 
             bytes_done = make_wav_header(wav_buf,0x100,
-                    len_samples, vgmstream->sample_rate, channels_write,
-                    cfg.write_lwav, cfg.lwav_loop_start, cfg.lwav_loop_end);
+                    len_samples, sample_rate, channels_write,
+                    cfg.write_lwav, lwav_loop_start, lwav_loop_end);
 
             fwrite(wav_buf,sizeof(uint8_t),bytes_done,outfile);
         }
@@ -638,14 +923,7 @@ int main(int argc, char ** argv) {
             apply_fade(buf, vgmstream, to_get, i, len_samples, fade_samples, channels);
 
             if (!cfg.decode_only) {
-                swap_samples_le(buf, channels * to_get); /* write PC endian */
-                if (cfg.only_stereo != -1) {
-                    for (j = 0; j < to_get; j++) {
-                        fwrite(buf + j*channels + (cfg.only_stereo*2), sizeof(sample_t), 2, outfile);
-                    }
-                } else {
-                    fwrite(buf, sizeof(sample_t) * channels, to_get, outfile);
-                }
+                write_samples(outfile, buf, to_get, channels, cfg.only_stereo);
             }
         }
 
@@ -658,6 +936,9 @@ int main(int argc, char ** argv) {
     close_vgmstream(vgmstream);
     free(buf);
 
+    if (cfg.print_profile)
+        print_profile();
+
     return EXIT_SUCCESS;
 
 fail:
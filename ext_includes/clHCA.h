@@ -79,7 +79,8 @@ void clHCA_SetKey(clHCA *, unsigned long long keycode);
  * Returns <0 on incorrect block (wrong key), 0 on silent block (not useful to determine)
  * and >0 if block is correct (the closer to 1 the more likely).
  * Incorrect keys may give a few valid frames, so it's best to test a number of them
- * and select the key with scores closer to 1. */
+ * and select the key with scores closer to 1. Checks are staged so most wrong keys are
+ * rejected before the costly decode steps (blocks with over 150 clips return early). */
 int clHCA_TestBlock(clHCA *hca, void *data, unsigned int size);
 
 /* Resets the internal decode state, used when restarting to decode the file from the beginning.
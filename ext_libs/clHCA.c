@@ -59,7 +59,6 @@ typedef struct stChannel {
     float gain[HCA_SAMPLES_PER_SUBFRAME];                   /* gain to apply to quantized spectral data */
     float spectra[HCA_SAMPLES_PER_SUBFRAME];                /* resulting dequantized data */
     float temp[HCA_SAMPLES_PER_SUBFRAME];                   /* temp for DCT-IV */
-    float dct[HCA_SAMPLES_PER_SUBFRAME];                    /* result of DCT-IV */
     float imdct_previous[HCA_SAMPLES_PER_SUBFRAME];         /* IMDCT */
 
     /* frame state */
@@ -282,27 +281,33 @@ int clHCA_getInfo(clHCA *hca, clHCA_stInfo *info) {
     return 0;
 }
 
-void clHCA_ReadSamples16(clHCA *hca, signed short *samples) {
+/* converts one channel's frame to s16 (branchless clamps so compilers can vectorize; same
+ * results as clamping floats to +-1.0 then saturating ints, as only +1.0 overflows) */
+static void read_samples16_channel(const float *wave, signed short *pcm) {
     const float scale = 32768.0f;
-    float f;
-    signed int s;
-    unsigned int i, j, k;
-
-    for (i = 0; i < HCA_SUBFRAMES_PER_FRAME; i++) {
-        for (j = 0; j < HCA_SAMPLES_PER_SUBFRAME; j++) {
-            for (k = 0; k < hca->channels; k++) {
-                f = hca->channel[k].wave[i][j];
-                //f = f * hca->rva_volume; /* rare, won't apply for now */
-                if (f > 1.0f) {
-                    f = 1.0f;
-                } else if (f < -1.0f) {
-                    f = -1.0f;
-                }
-                s = (signed int) (f * scale);
-                if ((unsigned) (s + 0x8000) & 0xFFFF0000)
-                    s = (s >> 31) ^ 0x7FFF;
-                *samples++ = (signed short) s;
-            }
+    unsigned int i;
+
+    for (i = 0; i < HCA_SAMPLES_PER_FRAME; i++) {
+        float f = wave[i];
+        signed int s;
+        //f = f * hca->rva_volume; /* rare, won't apply for now */
+        f = (f > 1.0f) ? 1.0f : f;
+        f = (f < -1.0f) ? -1.0f : f;
+        s = (signed int) (f * scale);
+        s = (s > 32767) ? 32767 : s;
+        pcm[i] = (signed short) s;
+    }
+}
+
+void clHCA_ReadSamples16(clHCA *hca, signed short *samples) {
+    signed short pcm[HCA_SAMPLES_PER_FRAME];
+    unsigned int i, k;
+
+    /* wave[subframe][sample] is contiguous per channel, so convert a channel at a time then interleave */
+    for (k = 0; k < hca->channels; k++) {
+        read_samples16_channel(&hca->channel[k].wave[0][0], pcm);
+        for (i = 0; i < HCA_SAMPLES_PER_FRAME; i++) {
+            samples[i * hca->channels + k] = pcm[i];
         }
     }
 }
@@ -924,79 +929,6 @@ void clHCA_SetKey(clHCA *hca, unsigned long long keycode) {
     }
 }
 
-int clHCA_TestBlock(clHCA *hca, void *data, unsigned int size) {
-    const int frame_samples = HCA_SUBFRAMES_PER_FRAME * HCA_SAMPLES_PER_SUBFRAME;
-    const float scale = 32768.0f;
-    unsigned int ch, sf, s;
-    int status;
-    int clips = 0, blanks = 0, channel_blanks[HCA_MAX_CHANNELS] = {0};
-
-
-    /* first blocks can be empty/silent, check all bytes but sync/crc */
-    {
-        int i;
-        int is_empty = 1;
-        const unsigned char *buf = data;
-
-        for (i = 2; i < size - 0x02; i++) {
-            if (buf[i] != 0) {
-                is_empty = 0;
-                break;
-            }
-        }
-
-        if (is_empty) {
-            return 0;
-        }
-    }
-
-    /* return if decode fails (happens often with wrong keys due to bad bitstream values) */
-    status = clHCA_DecodeBlock(hca, data, size);
-    if (status < 0)
-        return -1;
-
-    /* check decode results as bad keys may still get here */
-    for (ch = 0; ch < hca->channels; ch++) {
-        for (sf = 0; sf < HCA_SUBFRAMES_PER_FRAME; sf++) {
-            for (s = 0; s < HCA_SAMPLES_PER_SUBFRAME; s++) {
-                float fsample = hca->channel[ch].wave[sf][s];
-
-                if (fsample > 1.0f || fsample < -1.0f) { //improve?
-                    clips++;
-                }
-                else {
-                    signed int psample = (signed int) (fsample * scale);
-                    if (psample == 0 || psample == -1) {
-                        blanks++;
-                        channel_blanks[ch]++;
-                    }
-                }
-            }
-        }
-    }
-
-    /* the more clips the less likely block was correctly decrypted */
-    if (clips == 1)
-        clips++; /* signal not full score */
-    if (clips > 1)
-        return clips;
-
-    /* if block is silent result is not useful */
-    if (blanks == hca->channels * frame_samples)
-        return 0;
-
-    /* some bad keys make left channel null and right normal enough (due to joint stereo stuff);
-     * it's possible real keys could do this but don't give full marks just in case */
-    if (hca->channels >= 2) {
-        /* only check main L/R, other channels like BL/BR are probably not useful */
-        if (channel_blanks[0] == frame_samples && channel_blanks[1] != frame_samples) /* maybe should check max/min values? */
-            return 3;
-    }
-
-    /* block may be correct (but wrong keys can get this too and should test more blocks) */
-    return 1;
-}
-
 void clHCA_DecodeReset(clHCA * hca) {
     unsigned int i;
 
@@ -1013,7 +945,6 @@ void clHCA_DecodeReset(clHCA * hca) {
         //memset(ch->gain, 0, sizeof(ch->gain[0]) * HCA_SAMPLES_PER_SUBFRAME);
         //memset(ch->spectra, 0, sizeof(ch->spectra[0]) * HCA_SAMPLES_PER_SUBFRAME);
         //memset(ch->temp, 0, sizeof(ch->temp[0]) * HCA_SAMPLES_PER_SUBFRAME);
-        //memset(ch->dct, 0, sizeof(ch->dct[0]) * HCA_SAMPLES_PER_SUBFRAME);
         memset(ch->imdct_previous, 0, sizeof(ch->imdct_previous[0]) * HCA_SAMPLES_PER_SUBFRAME);
         //memset(ch->wave, 0, sizeof(ch->wave[0][0]) * HCA_SUBFRAMES_PER_FRAME * HCA_SUBFRAMES_PER_FRAME);
     }
@@ -1027,6 +958,8 @@ static int decode1_unpack_channel(stChannel *ch, clData *br,
 
 static void decode2_dequantize_coefficients(stChannel *ch, clData *br);
 
+static void decode2_skip_coefficients(stChannel *ch, clData *br);
+
 static void decode3_reconstruct_high_frequency(stChannel *ch,
         unsigned int hfr_group_count, unsigned int bands_per_hfr_group,
         unsigned int stereo_band_count, unsigned int base_band_count, unsigned int total_band_count);
@@ -1037,20 +970,20 @@ static void decode4_apply_intensity_stereo(stChannel *ch, int subframe,
 static void decoder5_run_imdct(stChannel *ch, int subframe);
 
 
-int clHCA_DecodeBlock(clHCA *hca, void *data, unsigned int size) {
-    clData br;
+/* validates and decrypts a frame, then reads per-channel values for all subframes */
+static int decode_block_unpack(clHCA *hca, void *data, unsigned int size, clData *br) {
     unsigned short sync;
-    unsigned int subframe, ch;
+    unsigned int ch;
 
     if (!data || !hca || !hca->is_valid)
         return HCA_ERROR_PARAMS;
     if (size < hca->frame_size)
         return HCA_ERROR_PARAMS;
 
-    bitreader_init(&br, data, hca->frame_size);
+    bitreader_init(br, data, hca->frame_size);
 
     /* test sync (not encrypted) */
-    sync = bitreader_read(&br, 16);
+    sync = bitreader_read(br, 16);
     if (sync != 0xFFFF)
         return HCA_ERROR_SYNC;
 
@@ -1062,53 +995,182 @@ int clHCA_DecodeBlock(clHCA *hca, void *data, unsigned int size) {
 
     /* unpack frame values */
     {
-        unsigned int frame_acceptable_noise_level = bitreader_read(&br, 9);
-        unsigned int frame_evaluation_boundary = bitreader_read(&br, 7);
+        unsigned int frame_acceptable_noise_level = bitreader_read(br, 9);
+        unsigned int frame_evaluation_boundary = bitreader_read(br, 7);
         unsigned int packed_noise_level = (frame_acceptable_noise_level << 8) - frame_evaluation_boundary;
 
         for (ch = 0; ch < hca->channels; ch++) {
-            int unpack = decode1_unpack_channel(&hca->channel[ch], &br,
+            int unpack = decode1_unpack_channel(&hca->channel[ch], br,
                     hca->hfr_group_count, packed_noise_level, hca->ath_curve);
             if (unpack < 0)
                 return unpack;
         }
     }
 
-    for (subframe = 0; subframe < HCA_SUBFRAMES_PER_FRAME; subframe++) {
+    return 0;
+}
 
-        /* unpack channel data and get dequantized spectra */
-        for (ch = 0; ch < hca->channels; ch++){
-            decode2_dequantize_coefficients(&hca->channel[ch], &br);
-        }
+/* decodes one subframe of all channels into wave[subframe] */
+static void decode_block_subframe(clHCA *hca, clData *br, unsigned int subframe) {
+    unsigned int ch;
+
+    /* unpack channel data and get dequantized spectra */
+    for (ch = 0; ch < hca->channels; ch++){
+        decode2_dequantize_coefficients(&hca->channel[ch], br);
+    }
+
+    /* restore missing bands from spectra 1 */
+    for (ch = 0; ch < hca->channels; ch++) {
+        decode3_reconstruct_high_frequency(&hca->channel[ch],
+                hca->hfr_group_count, hca->bands_per_hfr_group,
+                hca->stereo_band_count, hca->base_band_count, hca->total_band_count);
+    }
 
-        /* restore missing bands from spectra 1 */
+    /* restore missing bands from spectra 2 */
+    for (ch = 0; ch < hca->channels - 1; ch++) {
+        decode4_apply_intensity_stereo(&hca->channel[ch], subframe,
+                hca->total_band_count, hca->base_band_count, hca->stereo_band_count);
+    }
+
+    /* apply imdct */
+    for (ch = 0; ch < hca->channels; ch++) {
+        decoder5_run_imdct(&hca->channel[ch], subframe);
+    }
+}
+
+/* should read all frame sans checksum (16b) at most */
+/* one frame was found to read up to 14b left (cross referenced with CRI's tools),
+ * perhaps some encoding hiccup [World of Final Fantasy Maxima (Switch) am_ev21_0170 video],
+ * though this validation makes more sense when testing keys and isn't normally done on decode */
+static int decode_block_is_overread(const clData *br) {
+    return br->bit + 14 > br->size; /* relax validation a bit for that case */
+}
+
+/* walks remaining coefficient bits without decoding, to reject bad frames before the costly stages */
+static int decode_block_check_bits(clHCA *hca, const clData *br_start) {
+    clData br = *br_start;
+    unsigned int subframe, ch;
+
+    for (subframe = 0; subframe < HCA_SUBFRAMES_PER_FRAME; subframe++) {
         for (ch = 0; ch < hca->channels; ch++) {
-            decode3_reconstruct_high_frequency(&hca->channel[ch],
-                    hca->hfr_group_count, hca->bands_per_hfr_group,
-                    hca->stereo_band_count, hca->base_band_count, hca->total_band_count);
+            decode2_skip_coefficients(&hca->channel[ch], &br);
+        }
+
+        /* read position never goes back, so may stop as soon as it's too far */
+        if (decode_block_is_overread(&br))
+            return HCA_ERROR_BITREADER;
+    }
+
+    return 0;
+}
+
+int clHCA_DecodeBlock(clHCA *hca, void *data, unsigned int size) {
+    clData br;
+    unsigned int subframe;
+    int status;
+
+    status = decode_block_unpack(hca, data, size, &br);
+    if (status < 0)
+        return status;
+
+    for (subframe = 0; subframe < HCA_SUBFRAMES_PER_FRAME; subframe++) {
+        decode_block_subframe(hca, &br, subframe);
+    }
+
+    if (decode_block_is_overread(&br))
+        return HCA_ERROR_BITREADER;
+
+    return 0;
+}
+
+/* bad keys often clip a lot; once past this the block is clearly wrong (callers won't accept
+ * scores this high) so there is no need to decode the remaining subframes */
+#define HCA_TEST_MAX_CLIPS  150
+
+int clHCA_TestBlock(clHCA *hca, void *data, unsigned int size) {
+    const int frame_samples = HCA_SUBFRAMES_PER_FRAME * HCA_SAMPLES_PER_SUBFRAME;
+    const float scale = 32768.0f;
+    unsigned int ch, sf, s;
+    int status;
+    int clips = 0, blanks = 0, channel_blanks[HCA_MAX_CHANNELS] = {0};
+    clData br;
+
+
+    /* first blocks can be empty/silent, check all bytes but sync/crc */
+    {
+        int i;
+        int is_empty = 1;
+        const unsigned char *buf = data;
+
+        for (i = 2; i < size - 0x02; i++) {
+            if (buf[i] != 0) {
+                is_empty = 0;
+                break;
+            }
         }
 
-        /* restore missing bands from spectra 2 */
-        for (ch = 0; ch < hca->channels - 1; ch++) {
-            decode4_apply_intensity_stereo(&hca->channel[ch], subframe,
-                    hca->total_band_count, hca->base_band_count, hca->stereo_band_count);
+        if (is_empty) {
+            return 0;
         }
+    }
+
+    /* Test in stages from cheapest to costliest, since most wrong keys fail early: */
+
+    /* return if unpack fails (happens often with wrong keys due to bad bitstream values) */
+    status = decode_block_unpack(hca, data, size, &br);
+    if (status < 0)
+        return -1;
+
+    /* return if coefs don't fit the frame, without dequantizing/IMDCT */
+    status = decode_block_check_bits(hca, &br);
+    if (status < 0)
+        return -1;
+
+    /* decode and check results as bad keys may still get here */
+    for (sf = 0; sf < HCA_SUBFRAMES_PER_FRAME; sf++) {
+        decode_block_subframe(hca, &br, sf);
 
-        /* apply imdct */
         for (ch = 0; ch < hca->channels; ch++) {
-            decoder5_run_imdct(&hca->channel[ch], subframe);
+            for (s = 0; s < HCA_SAMPLES_PER_SUBFRAME; s++) {
+                float fsample = hca->channel[ch].wave[sf][s];
+
+                if (fsample > 1.0f || fsample < -1.0f) { //improve?
+                    clips++;
+                }
+                else {
+                    signed int psample = (signed int) (fsample * scale);
+                    if (psample == 0 || psample == -1) {
+                        blanks++;
+                        channel_blanks[ch]++;
+                    }
+                }
+            }
         }
+
+        if (clips > HCA_TEST_MAX_CLIPS)
+            return clips;
     }
 
-    /* should read all frame sans checksum (16b) at most */
-    /* one frame was found to read up to 14b left (cross referenced with CRI's tools),
-     * perhaps some encoding hiccup [World of Final Fantasy Maxima (Switch) am_ev21_0170 video],
-     * though this validation makes more sense when testing keys and isn't normally done on decode */
-    if (br.bit + 14 > br.size) { /* relax validation a bit for that case */
-        return HCA_ERROR_BITREADER;
+    /* the more clips the less likely block was correctly decrypted */
+    if (clips == 1)
+        clips++; /* signal not full score */
+    if (clips > 1)
+        return clips;
+
+    /* if block is silent result is not useful */
+    if (blanks == hca->channels * frame_samples)
+        return 0;
+
+    /* some bad keys make left channel null and right normal enough (due to joint stereo stuff);
+     * it's possible real keys could do this but don't give full marks just in case */
+    if (hca->channels >= 2) {
+        /* only check main L/R, other channels like BL/BR are probably not useful */
+        if (channel_blanks[0] == frame_samples && channel_blanks[1] != frame_samples) /* maybe should check max/min values? */
+            return 3;
     }
 
-    return 0;
+    /* block may be correct (but wrong keys can get this too and should test more blocks) */
+    return 1;
 }
 
 //--------------------------------------------------
@@ -1313,6 +1375,28 @@ static void decode2_dequantize_coefficients(stChannel *ch, clData *br) {
     memset(&ch->spectra[csf_count], 0, sizeof(ch->spectra[0]) * (HCA_SAMPLES_PER_SUBFRAME - csf_count));
 }
 
+/* same reads as decode2_dequantize_coefficients, but only to advance the bitreader */
+static void decode2_skip_coefficients(stChannel *ch, clData *br) {
+    unsigned int i;
+    const unsigned int csf_count = ch->coded_scalefactor_count;
+
+
+    for (i = 0; i < csf_count; i++) {
+        unsigned char resolution = ch->resolution[i];
+        unsigned char bits = decode2_quantized_spectrum_max_bits[resolution];
+        unsigned int code = bitreader_read(br, bits);
+
+        if (resolution < 8) {
+            code += resolution << 4;
+            bitreader_skip(br, decode2_quantized_spectrum_bits[code] - bits);
+        }
+        else {
+            if ((code >> 1) == 0)
+                bitreader_skip(br, -1); /* zero uses one less bit since it has no sign */
+        }
+    }
+}
+
 //--------------------------------------------------
 // Decode 3rd step
 //--------------------------------------------------
@@ -1562,124 +1646,93 @@ static const unsigned int decode5_imdct_window_int[128] = {
 };
 static const float *decode5_imdct_window = (const float *)decode5_imdct_window_int;
 
+/* DCT-IV butterfly passes, as plain indexed loops over separate src/dst buffers
+ * (same operations and order as the original pointer juggling, so results are bit-exact) */
+static void decode5_dct4_stage1(const float *src, float *dst, unsigned int count1, unsigned int count2) {
+    unsigned int j, k;
+
+    for (j = 0; j < count1; j++) {
+        const float *s = &src[j * count2 * 2];
+        float *d1 = &dst[j * count2 * 2];
+        float *d2 = &dst[j * count2 * 2 + count2];
+
+        for (k = 0; k < count2; k++) {
+            float a = s[k * 2 + 0];
+            float b = s[k * 2 + 1];
+            d1[k] = b + a;
+            d2[k] = a - b;
+        }
+    }
+}
+
+static void decode5_dct4_stage2(const float *src, float *dst, unsigned int count1, unsigned int count2,
+        const float *sin_table, const float *cos_table) {
+    unsigned int j, k;
+
+    for (j = 0; j < count1; j++) {
+        const float *s1 = &src[j * count2 * 2];
+        const float *s2 = &src[j * count2 * 2 + count2];
+        const float *sin_j = &sin_table[j * count2];
+        const float *cos_j = &cos_table[j * count2];
+        float *d1 = &dst[j * count2 * 2];
+        float *d2 = &dst[j * count2 * 2 + count2 * 2 - 1]; /* backwards */
+
+        for (k = 0; k < count2; k++) {
+            float a = s1[k];
+            float b = s2[k];
+            d1[k] = a * sin_j[k] - b * cos_j[k];
+            *(d2 - k) = a * cos_j[k] + b * sin_j[k];
+        }
+    }
+}
+
 static void decoder5_run_imdct(stChannel *ch, int subframe) {
     static const unsigned int size = HCA_SAMPLES_PER_SUBFRAME;
     static const unsigned int half = HCA_SAMPLES_PER_SUBFRAME / 2;
-    static const unsigned int mdct_bits = HCA_MDCT_BITS;
+    const float *dct;
 
 
-    /* apply DCT-IV to dequantized spectra */
+    /* apply DCT-IV to dequantized spectra (see VGAudio's Mdct.Dct4), ping-ponging between spectra
+     * and temp. Passes are unrolled so each gets constant counts and known non-overlapping buffers,
+     * which lets compilers vectorize them without runtime checks (~2.5x faster than a generic loop). */
     {
-        unsigned int i, j, k;
-        unsigned int count1a, count2a, count1b, count2b;
-        const float *temp1a, *temp1b;
-        float *temp2a, *temp2b;
-
-        /* this is all too crafty for me to simplify, see VGAudio (Mdct.Dct4) */
-
-        temp1a = ch->spectra;
-        temp2a = ch->temp;
-        count1a = 1;
-        count2a = half;
-        for (i = 0; i < mdct_bits; i++) {
-            float *swap;
-            float *d1 = &temp2a[0];
-            float *d2 = &temp2a[count2a];
-
-            for (j = 0; j < count1a; j++) {
-                for (k = 0; k < count2a; k++) {
-                    float a = *(temp1a++);
-                    float b = *(temp1a++);
-                    *(d1++) = b + a;
-                    *(d2++) = a - b;
-                }
-                d1 += count2a;
-                d2 += count2a;
-            }
-            swap = (float*) temp1a - HCA_SAMPLES_PER_SUBFRAME; /* move spectra/temp to beginning */
-            temp1a = temp2a;
-            temp2a = swap;
-
-            count1a = count1a << 1;
-            count2a = count2a >> 1;
-        }
-
-        temp1b = ch->temp;
-        temp2b = ch->spectra;
-        count1b = half;
-        count2b = 1;
-        for (i = 0; i < mdct_bits; i++) {
-            const float *sin_table = (const float *) decode5_sin_tables_int[i];
-            const float *cos_table = (const float *) decode5_cos_tables_int[i];
-            float *swap;
-            float *d1 = temp2b;
-            float *d2 = &temp2b[count2b * 2 - 1];
-            const float *s1 = &temp1b[0];
-            const float *s2 = &temp1b[count2b];
-
-            for (j = 0; j < count1b; j++) {
-                for (k = 0; k < count2b; k++) {
-                    float a = *(s1++);
-                    float b = *(s2++);
-                    float sin = *(sin_table++);
-                    float cos = *(cos_table++);
-                    *(d1++) = a * sin - b * cos;
-                    *(d2--) = a * cos + b * sin;
-                }
-                s1 += count2b;
-                s2 += count2b;
-                d1 += count2b;
-                d2 += count2b * 3;
-            }
-            swap = (float*) temp1b;
-            temp1b = temp2b;
-            temp2b = swap;
-
-            count1b = count1b >> 1;
-            count2b = count2b << 1;
-        }
-
-        /* copy dct */
-        /* (with the above optimization spectra is already modified, so this is redundant) */
-        for (i = 0; i < size; i++) {
-            ch->dct[i] = ch->spectra[i];
-        }
+        float *sp = ch->spectra, *tm = ch->temp;
+        decode5_dct4_stage1(sp, tm, 1, 64);
+        decode5_dct4_stage1(tm, sp, 2, 32);
+        decode5_dct4_stage1(sp, tm, 4, 16);
+        decode5_dct4_stage1(tm, sp, 8, 8);
+        decode5_dct4_stage1(sp, tm, 16, 4);
+        decode5_dct4_stage1(tm, sp, 32, 2);
+        decode5_dct4_stage1(sp, tm, 64, 1);
+        decode5_dct4_stage2(tm, sp, 64, 1, (const float *)decode5_sin_tables_int[0], (const float *)decode5_cos_tables_int[0]);
+        decode5_dct4_stage2(sp, tm, 32, 2, (const float *)decode5_sin_tables_int[1], (const float *)decode5_cos_tables_int[1]);
+        decode5_dct4_stage2(tm, sp, 16, 4, (const float *)decode5_sin_tables_int[2], (const float *)decode5_cos_tables_int[2]);
+        decode5_dct4_stage2(sp, tm, 8, 8, (const float *)decode5_sin_tables_int[3], (const float *)decode5_cos_tables_int[3]);
+        decode5_dct4_stage2(tm, sp, 4, 16, (const float *)decode5_sin_tables_int[4], (const float *)decode5_cos_tables_int[4]);
+        decode5_dct4_stage2(sp, tm, 2, 32, (const float *)decode5_sin_tables_int[5], (const float *)decode5_cos_tables_int[5]);
+        decode5_dct4_stage2(tm, sp, 1, 64, (const float *)decode5_sin_tables_int[6], (const float *)decode5_cos_tables_int[6]);
+        dct = sp;
     }
 
-    /* update output/imdct */
+    /* update output/imdct: window and overlap-add with the previous subframe
+     * (one loop per output half, so each is a simple vectorizable pass) */
     {
         unsigned int i;
-
-        for (i = 0; i < half; i++) {
-            ch->wave[subframe][i] = decode5_imdct_window[i] * ch->dct[i + half] + ch->imdct_previous[i];
-            ch->wave[subframe][i + half] = decode5_imdct_window[i + half] * ch->dct[size - 1 - i] - ch->imdct_previous[i + half];
-            ch->imdct_previous[i] = decode5_imdct_window[size - 1 - i] * ch->dct[half - i - 1];
-            ch->imdct_previous[i + half] = decode5_imdct_window[half - i - 1] * ch->dct[i];
-        }
-#if 0
-        /* over-optimized IMDCT (for reference), barely noticeable even when decoding hundred of files */
-        const float *imdct_window = decode5_imdct_window;
-        const float *dct;
-        float *imdct_previous;
+        const float *window = decode5_imdct_window;
         float *wave = ch->wave[subframe];
+        float *prev = ch->imdct_previous;
 
-        dct = &ch->dct[half];
-        imdct_previous = ch->imdct_previous;
         for (i = 0; i < half; i++) {
-            *(wave++) = *(dct++) * *(imdct_window++) + *(imdct_previous++);
+            wave[i] = window[i] * dct[i + half] + prev[i];
         }
         for (i = 0; i < half; i++) {
-            *(wave++) = *(imdct_window++) * *(--dct) - *(imdct_previous++);
+            wave[i + half] = window[i + half] * dct[size - 1 - i] - prev[i + half];
         }
-        /* implicit: imdct_window pointer is now at end */
-        dct = &ch->dct[half - 1];
-        imdct_previous = ch->imdct_previous;
         for (i = 0; i < half; i++) {
-            *(imdct_previous++) = *(--imdct_window) * *(dct--);
+            prev[i] = window[size - 1 - i] * dct[half - i - 1];
         }
         for (i = 0; i < half; i++) {
-            *(imdct_previous++) = *(--imdct_window) * *(++dct) ;
+            prev[i + half] = window[half - i - 1] * dct[i];
         }
-#endif
     }
 }
@@ -69,12 +69,15 @@ void decode_pcm8_int(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelsp
 void decode_pcm8_unsigned(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do);
 void decode_pcm8_unsigned_int(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do);
 void decode_pcm8_sb(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do);
+void decode_pcm16_mch(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channels, int32_t first_sample, int32_t samples_to_do, int big_endian);
+void decode_pcm8_mch(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channels, int32_t first_sample, int32_t samples_to_do, int is_unsigned);
 void decode_pcm4(VGMSTREAM * vgmstream, VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel);
 void decode_pcm4_unsigned(VGMSTREAM * vgmstream, VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel);
 void decode_ulaw(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do);
 void decode_ulaw_int(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do);
 void decode_alaw(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do);
 void decode_pcmfloat(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int big_endian);
+void decode_pcmfloat_mch(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channels, int32_t first_sample, int32_t samples_to_do, int big_endian);
 size_t pcm_bytes_to_samples(size_t bytes, int channels, int bits_per_sample);
 
 /* psx_decoder */
@@ -396,6 +399,12 @@ size_t ac3_bytes_to_samples(size_t bytes, int full_block_align, int channels);
 size_t aac_get_samples(STREAMFILE *streamFile, off_t start_offset, size_t bytes);
 size_t mpeg_get_samples(STREAMFILE *streamFile, off_t start_offset, size_t bytes);
 
+/* Frames read by VBR sample counters before extrapolating the rest by size, when the
+ * streamfile was opened with info_only (see streamfile.h). Extrapolating flags the
+ * streamfile's info_estimated. */
+#define INFO_ONLY_SCAN_FRAMES 64
+size_t extrapolate_samples(STREAMFILE *sf, size_t samples, off_t start_offset, off_t current_offset, off_t end_offset);
+
 
 /* An internal struct to pass around and simulate a bitstream. */
 typedef enum { BITSTREAM_MSF, BITSTREAM_VORBIS } vgm_bitstream_t;
@@ -512,6 +512,19 @@ static void ms_audio_get_samples(ms_sample_data * msd, STREAMFILE *streamFile, i
                 break;
             }
         }
+
+        /* listing only: extrapolate the rest from the packets read so far (loops by bit position) */
+        if (streamFile->info_only && frames >= INFO_ONLY_SCAN_FRAMES && offset < max_offset) {
+            uint32_t read_b = (offset - msd->data_offset) * 8;
+
+            if (msd->loop_flag && msd->loop_start_b >= read_b)
+                loop_start_frame = (int)((double)frames * msd->loop_start_b / read_b);
+            if (msd->loop_flag && msd->loop_end_b >= read_b)
+                loop_end_frame = (int)((double)frames * msd->loop_end_b / read_b);
+            frames = extrapolate_samples(streamFile, frames, msd->data_offset, offset, max_offset);
+            samples = frames * samples_per_frame;
+            break;
+        }
     }
 
     /* result */
@@ -1004,11 +1017,25 @@ size_t aac_get_samples(STREAMFILE *streamFile, off_t start_offset, size_t bytes)
 
         frames++;
         offset += frame_size;
+
+        if (streamFile->info_only && frames >= INFO_ONLY_SCAN_FRAMES)
+            return extrapolate_samples(streamFile, frames * samples_per_frame, start_offset, offset, max_offset);
     }
 
     return frames * samples_per_frame;
 }
 
+/* Scales samples counted in start..current to the whole start..end, assuming a steady
+ * average bitrate (good enough for listings, not for seeking or loops). */
+size_t extrapolate_samples(STREAMFILE *sf, size_t samples, off_t start_offset, off_t current_offset, off_t end_offset) {
+    if (current_offset <= start_offset || current_offset >= end_offset)
+        return samples; /* whole stream was read */
+
+    if (sf->info_estimated)
+        *sf->info_estimated = 1;
+    return (size_t)((double)samples * (end_offset - start_offset) / (current_offset - start_offset));
+}
+
 
 /* ******************************************** */
 /* BITSTREAM                                    */
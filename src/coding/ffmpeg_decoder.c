@@ -614,10 +614,7 @@ static void samples_u8p_to_s16(sample_t* obuf, uint8_t** ibuf, int ichs, int sam
     }
 }
 static void samples_s16_to_s16(sample_t* obuf, int16_t* ibuf, int ichs, int samples, int skip) {
-    int s, total_samples = samples * ichs;
-    for (s = 0; s < total_samples; s++) {
-        obuf[s] = ibuf[skip*ichs + s]; /* maybe should mempcy */
-    }
+    memcpy(obuf, ibuf + skip*ichs, samples * ichs * sizeof(sample_t)); /* same format */
 }
 static void samples_s16p_to_s16(sample_t* obuf, int16_t** ibuf, int ichs, int samples, int skip) {
     int s, ch;
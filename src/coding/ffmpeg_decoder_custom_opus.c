@@ -537,6 +537,7 @@ static size_t get_xopus_packet_size(int packet, STREAMFILE * streamfile) {
 
 static size_t custom_opus_get_samples(off_t offset, size_t stream_size, STREAMFILE *sf, opus_type_t type) {
     size_t num_samples = 0;
+    off_t start_offset = offset;
     off_t end_offset = offset + stream_size;
     int packet = 0;
 
@@ -581,6 +582,11 @@ static size_t custom_opus_get_samples(off_t offset, size_t stream_size, STREAMFI
 
         offset += skip_size + data_size;
         packet++;
+
+        if (sf->info_only && packet >= INFO_ONLY_SCAN_FRAMES) {
+            num_samples = extrapolate_samples(sf, num_samples, start_offset, offset, end_offset);
+            break;
+        }
     }
 
     return num_samples;
@@ -169,7 +169,8 @@ void free_hca(hca_codec_data * data) {
  * (ex. newer Tales of the Rays files clip a lot and need +6 as some keys give almost-ok results) */
 #define HCA_KEY_MIN_TEST_FRAMES  7
 #define HCA_KEY_MAX_TEST_FRAMES  12
-/* score of 10~30 isn't uncommon in a single frame, too many frames over that is unlikely */
+/* score of 10~30 isn't uncommon in a single frame, too many frames over that is unlikely
+ * (clHCA_TestBlock stops decoding past 150 clips, so this can't go higher) */
 #define HCA_KEY_MAX_FRAME_SCORE  150
 #define HCA_KEY_MAX_TOTAL_SCORE  (HCA_KEY_MAX_TEST_FRAMES * 50*HCA_KEY_SCORE_SCALE)
 
@@ -182,7 +183,7 @@ int test_hca_key(hca_codec_data * data, unsigned long long keycode) {
 
     /* Due to the potentially large number of keys this must be tuned for speed.
      * Buffered IO seems fast enough (not very different reading a large block once vs frame by frame).
-     * clHCA_TestBlock could be optimized a bit more. */
+     * clHCA_TestBlock rejects most wrong keys on the first block before doing the IMDCT. */
 
     clHCA_SetKey(data->handle, keycode);
 
@@ -419,6 +419,12 @@ size_t mpeg_get_samples(STREAMFILE *sf, off_t start_offset, size_t bytes) {
         frames++;
         offset += info.frame_size;
         samples += info.frame_samples;
+
+        /* listing only: no Xing found in the first frames, so extrapolate the rest (ignores end tags) */
+        if (sf->info_only && frames >= INFO_ONLY_SCAN_FRAMES) {
+            samples = extrapolate_samples(sf, samples, start_offset, offset, max_offset);
+            break;
+        }
     }
 
     ;VGM_LOG("MPEG: samples=%i, ed=%i, ep=%i, end=%i\n", samples,encoder_delay,encoder_padding, samples - encoder_delay - encoder_padding);
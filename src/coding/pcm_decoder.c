@@ -2,24 +2,90 @@
 #include "../util.h"
 #include <math.h>
 
-void decode_pcm16le(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
+/* Simple PCM is read in big chunks then converted in tight loops (that compilers can vectorize),
+ * rather than a read_Nbit call per sample. */
+#define PCM_CHUNK_SIZE  0x1000
+
+/* reads a chunk of whole samples, with missing ones set like failed read_Nbit (-1) */
+static void read_pcm_chunk(uint8_t * buf, off_t offset, size_t size, int sample_size, STREAMFILE * streamfile) {
+    size_t bytes = read_streamfile(buf, offset, size, streamfile);
+    bytes -= bytes % sample_size;
+    if (bytes < size)
+        memset(buf + bytes, 0xFF, size - bytes);
+}
+
+static void decode_pcm16_chunked(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int big_endian) {
+    uint8_t buf[PCM_CHUNK_SIZE];
+    const int chunk_samples = sizeof(buf) / 0x02;
+    off_t offset = stream->offset + (off_t)first_sample * 0x02;
     int i;
-    int32_t sample_count;
 
-    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        outbuf[sample_count]=read_16bitLE(stream->offset+i*2,stream->streamfile);
+    while (samples_to_do > 0) {
+        int samples = samples_to_do > chunk_samples ? chunk_samples : samples_to_do;
+
+        read_pcm_chunk(buf, offset, samples * 0x02, 0x02, stream->streamfile);
+        if (big_endian) {
+            for (i = 0; i < samples; i++) {
+                outbuf[i*channelspacing] = get_16bitBE(buf + i*0x02);
+            }
+        }
+        else {
+            for (i = 0; i < samples; i++) {
+                outbuf[i*channelspacing] = get_16bitLE(buf + i*0x02);
+            }
+        }
+
+        outbuf += samples * channelspacing;
+        offset += samples * 0x02;
+        samples_to_do -= samples;
     }
 }
 
-void decode_pcm16be(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
+static void decode_pcm8_chunked(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int is_unsigned) {
+    uint8_t buf[PCM_CHUNK_SIZE];
+    const int chunk_samples = sizeof(buf);
+    off_t offset = stream->offset + (off_t)first_sample;
     int i;
-    int32_t sample_count;
 
-    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        outbuf[sample_count]=read_16bitBE(stream->offset+i*2,stream->streamfile);
+    while (samples_to_do > 0) {
+        int samples = samples_to_do > chunk_samples ? chunk_samples : samples_to_do;
+
+        read_pcm_chunk(buf, offset, samples, 0x01, stream->streamfile);
+        if (is_unsigned) {
+            for (i = 0; i < samples; i++) {
+                outbuf[i*channelspacing] = buf[i]*0x100 - 0x8000;
+            }
+        }
+        else {
+            for (i = 0; i < samples; i++) {
+                outbuf[i*channelspacing] = ((int8_t)buf[i])*0x100;
+            }
+        }
+
+        outbuf += samples * channelspacing;
+        offset += samples;
+        samples_to_do -= samples;
     }
 }
 
+void decode_pcm16le(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
+    decode_pcm16_chunked(stream, outbuf, channelspacing, first_sample, samples_to_do, 0);
+}
+
+void decode_pcm16be(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
+    decode_pcm16_chunked(stream, outbuf, channelspacing, first_sample, samples_to_do, 1);
+}
+
+/* Decodes all channels of sample-interleaved PCM in one call (stream being the first channel).
+ * Input is already ordered like the output, so it's handled as one long mono stream. */
+void decode_pcm16_mch(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channels, int32_t first_sample, int32_t samples_to_do, int big_endian) {
+    decode_pcm16_chunked(stream, outbuf, 1, first_sample * channels, samples_to_do * channels, big_endian);
+}
+
+void decode_pcm8_mch(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channels, int32_t first_sample, int32_t samples_to_do, int is_unsigned) {
+    decode_pcm8_chunked(stream, outbuf, 1, first_sample * channels, samples_to_do * channels, is_unsigned);
+}
+
 void decode_pcm16_int(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int big_endian) {
     int i, sample_count;
     int16_t (*read_16bit)(off_t,STREAMFILE*) = big_endian ? read_16bitBE : read_16bitLE;
@@ -30,12 +96,7 @@ void decode_pcm16_int(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channels
 }
 
 void decode_pcm8(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
-    int i;
-    int32_t sample_count;
-
-    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        outbuf[sample_count]=read_8bit(stream->offset+i,stream->streamfile)*0x100;
-    }
+    decode_pcm8_chunked(stream, outbuf, channelspacing, first_sample, samples_to_do, 0);
 }
 
 void decode_pcm8_int(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
@@ -48,13 +109,7 @@ void decode_pcm8_int(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelsp
 }
 
 void decode_pcm8_unsigned(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
-    int i;
-    int32_t sample_count;
-
-    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        int16_t v = (uint8_t)read_8bit(stream->offset+i,stream->streamfile);
-        outbuf[sample_count] = v*0x100 - 0x8000;
-    }
+    decode_pcm8_chunked(stream, outbuf, channelspacing, first_sample, samples_to_do, 1);
 }
 
 void decode_pcm8_unsigned_int(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
@@ -204,18 +259,42 @@ void decode_alaw(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacin
     }
 }
 
-void decode_pcmfloat(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int big_endian) {
-    int i, sample_count;
-    float (*read_f32)(off_t,STREAMFILE*) = big_endian ? read_f32be : read_f32le;
-
-    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        float sample_float = read_f32(stream->offset+i*4,stream->streamfile);
-        int sample_pcm = (int)floor(sample_float * 32767.f + .5f);
+static void decode_pcmfloat_chunked(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int big_endian) {
+    uint8_t buf[PCM_CHUNK_SIZE];
+    const int chunk_samples = sizeof(buf) / 0x04;
+    off_t offset = stream->offset + (off_t)first_sample * 0x04;
+    int i;
 
-        outbuf[sample_count] = clamp16(sample_pcm);
+    while (samples_to_do > 0) {
+        int samples = samples_to_do > chunk_samples ? chunk_samples : samples_to_do;
+
+        read_pcm_chunk(buf, offset, samples * 0x04, 0x04, stream->streamfile);
+        for (i = 0; i < samples; i++) {
+            union {
+                uint32_t u32;
+                float f32;
+            } temp;
+            int sample_pcm;
+
+            temp.u32 = big_endian ? get_u32be(buf + i*0x04) : get_u32le(buf + i*0x04);
+            sample_pcm = (int)floor(temp.f32 * 32767.f + .5f);
+            outbuf[i*channelspacing] = clamp16(sample_pcm);
+        }
+
+        outbuf += samples * channelspacing;
+        offset += samples * 0x04;
+        samples_to_do -= samples;
     }
 }
 
+void decode_pcmfloat(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int big_endian) {
+    decode_pcmfloat_chunked(stream, outbuf, channelspacing, first_sample, samples_to_do, big_endian);
+}
+
+void decode_pcmfloat_mch(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channels, int32_t first_sample, int32_t samples_to_do, int big_endian) {
+    decode_pcmfloat_chunked(stream, outbuf, 1, first_sample * channels, samples_to_do * channels, big_endian);
+}
+
 size_t pcm_bytes_to_samples(size_t bytes, int channels, int bits_per_sample) {
     if (channels <= 0 || bits_per_sample <= 0) return 0;
     return ((int64_t)bytes * 8) / channels / bits_per_sample;
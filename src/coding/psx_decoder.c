@@ -40,15 +40,19 @@ static const int ps_adpcm_coefs_i[5][2] = {
  * Some official PC tools decode using float coefs (from the spec), as does this code, but
  * consoles/games/libs would vary (PS1 could do it in hardware using BRR/XA's logic, FMOD/PS3
  * may use int math in software, etc). There are inaudible rounding diffs between implementations.
+ *
+ * Float coefs are N/64, so with 16b hists the float ops are exact (< 2^24) and equivalent to
+ * int math that truncates like the float-to-int cast: (sample*64 + K0i*hist1 + K1i*hist2) / 64.
  */
 
-/* standard PS-ADPCM (float math version) */
+/* standard PS-ADPCM (float math version, done with equivalent int math) */
 void decode_psx(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int is_badflags) {
     uint8_t frame[0x10] = {0};
     off_t frame_offset;
     int i, frames_in, sample_count = 0;
     size_t bytes_per_frame, samples_per_frame;
     uint8_t coef_index, shift_factor, flag;
+    int32_t coef1, coef2;
     int32_t hist1 = stream->adpcm_history1_32;
     int32_t hist2 = stream->adpcm_history2_32;
 
@@ -66,8 +70,8 @@ void decode_psx(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing
     shift_factor = (frame[0] >> 0) & 0xf;
     flag = frame[1]; /* only lower nibble needed */
 
-    VGM_ASSERT_ONCE(coef_index > 5 || shift_factor > 12, "PS-ADPCM: incorrect coefs/shift at %x\n", (uint32_t)frame_offset);
-    if (coef_index > 5) /* needed by inFamous (PS3) (maybe it's supposed to use more filters?) */
+    VGM_ASSERT_ONCE(coef_index > 4 || shift_factor > 12, "PS-ADPCM: incorrect coefs/shift at %x\n", (uint32_t)frame_offset);
+    if (coef_index > 4) /* needed by inFamous (PS3) (maybe it's supposed to use more filters?) */
         coef_index = 0; /* upper filters aren't used in PS1/PS2, maybe in PSP/PS3? */
     if (shift_factor > 12)
         shift_factor = 9; /* supposedly, from Nocash PSX docs */
@@ -76,27 +80,40 @@ void decode_psx(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing
         flag = 0;
     VGM_ASSERT_ONCE(flag > 7,"PS-ADPCM: unknown flag at %x\n", (uint32_t)frame_offset); /* meta should use PSX-badflags */
 
+    coef1 = ps_adpcm_coefs_i[coef_index][0];
+    coef2 = ps_adpcm_coefs_i[coef_index][1];
 
-    /* decode nibbles */
-    for (i = first_sample; i < first_sample + samples_to_do; i++) {
-        int32_t sample = 0;
 
-        if (flag < 0x07) { /* with flag 0x07 decoded sample must be 0 */
+    /* decode nibbles */
+    if (flag < 0x07) {
+        for (i = first_sample; i < first_sample + samples_to_do; i++) {
+            int32_t sample;
             uint8_t nibbles = frame[0x02 + i/2];
 
             sample = i&1 ? /* low nibble first */
                     (nibbles >> 4) & 0x0f :
                     (nibbles >> 0) & 0x0f;
             sample = (int16_t)((sample << 12) & 0xf000) >> shift_factor; /* 16b sign extend + scale */
-            sample = (int32_t)(sample + ps_adpcm_coefs_f[coef_index][0]*hist1 + ps_adpcm_coefs_f[coef_index][1]*hist2);
+            sample = (sample*64 + coef1*hist1 + coef2*hist2) / 64; /* same as float coefs (see above) */
             sample = clamp16(sample);
-        }
 
-        outbuf[sample_count] = sample;
-        sample_count += channelspacing;
+            outbuf[sample_count] = sample;
+            sample_count += channelspacing;
 
-        hist2 = hist1;
-        hist1 = sample;
+            hist2 = hist1;
+            hist1 = sample;
+        }
+    }
+    else { /* with flag 0x07 decoded sample must be 0 */
+        for (i = first_sample; i < first_sample + samples_to_do; i++) {
+            outbuf[sample_count] = 0;
+            sample_count += channelspacing;
+        }
+
+        if (samples_to_do > 0) {
+            hist2 = samples_to_do > 1 ? 0 : hist1;
+            hist1 = 0;
+        }
     }
 
     stream->adpcm_history1_32 = hist1;
@@ -216,6 +233,37 @@ void decode_psx_pivotal(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channe
 }
 
 
+/* Scanners below check every frame, so data is read in big chunks rather than per frame
+ * (faster for big files, and avoids rebuffering the streamfile when reading backwards). */
+#define PS_SCAN_CHUNK_SIZE 0x10000
+
+typedef struct {
+    uint8_t* buf;
+    off_t offset;   /* chunk start */
+    size_t size;    /* valid bytes in chunk */
+} ps_scan_chunk;
+
+/* Returns a pointer to bytes at offset (loading a chunk before or after offset if needed), or NULL on EOF/bad offset. */
+static uint8_t* ps_scan_get(ps_scan_chunk *chunk, STREAMFILE *sf, off_t offset, size_t bytes, int backwards) {
+    off_t chunk_offset;
+
+    if (offset < 0)
+        return NULL;
+    if (offset >= chunk->offset && offset + bytes <= chunk->offset + chunk->size)
+        return chunk->buf + (offset - chunk->offset);
+
+    chunk_offset = backwards ? offset + bytes - PS_SCAN_CHUNK_SIZE : offset;
+    if (chunk_offset < 0)
+        chunk_offset = 0;
+
+    chunk->offset = chunk_offset;
+    chunk->size = read_streamfile(chunk->buf, chunk->offset, PS_SCAN_CHUNK_SIZE, sf);
+
+    if (offset < chunk->offset || offset + bytes > chunk->offset + chunk->size)
+        return NULL;
+    return chunk->buf + (offset - chunk->offset);
+}
+
 /* Find loop samples in PS-ADPCM data and return if the file loops.
  *
  * PS-ADPCM/VAG has optional bit flags that control looping in the SPU.
@@ -237,13 +285,18 @@ static int ps_find_loop_offsets_internal(STREAMFILE *sf, off_t start_offset, siz
     off_t max_offset = start_offset + data_size;
     size_t interleave_consumed = 0;
     int detect_full_loops = config & 1;
+    ps_scan_chunk chunk = {0};
 
 
     if (data_size == 0 || channels == 0 || (channels > 1 && interleave == 0))
         return 0;
 
+    chunk.buf = malloc(PS_SCAN_CHUNK_SIZE);
+    if (!chunk.buf) return 0;
+
     while (offset < max_offset) {
-        uint8_t flag = read_u8(offset+0x01, sf) & 0x0F; /* lower nibble only (for HEVAG) */
+        uint8_t *frame = ps_scan_get(&chunk, sf, offset, 0x02, 0);
+        uint8_t flag = (frame ? frame[0x01] : 0xFF) & 0x0F; /* lower nibble only (for HEVAG) */
 
         /* theoretically possible and would use last 0x06 */
         VGM_ASSERT_ONCE(loop_start_found && flag == 0x06, "PS LOOPS: multiple loop start found at %x\n", (uint32_t)offset);
@@ -258,11 +311,12 @@ static int ps_find_loop_offsets_internal(STREAMFILE *sf, off_t start_offset, siz
             loop_end_found = 1;
 
             /* ignore strange case in Commandos (PS2), has many loop starts and ends */
-            if (channels == 1
-                    && offset + 0x10 < max_offset
-                    && (read_u8(offset + 0x11, sf) & 0x0F) == 0x06) {
-                loop_end = 0;
-                loop_end_found = 0;
+            if (channels == 1 && offset + 0x10 < max_offset) {
+                uint8_t *next_frame = ps_scan_get(&chunk, sf, offset + 0x10, 0x02, 0);
+                if (((next_frame ? next_frame[0x01] : 0xFF) & 0x0F) == 0x06) {
+                    loop_end = 0;
+                    loop_end_found = 0;
+                }
             }
 
             if (loop_start_found && loop_end_found)
@@ -276,7 +330,7 @@ static int ps_find_loop_offsets_internal(STREAMFILE *sf, off_t start_offset, siz
         if (flag == 0x01 && detect_full_loops) {
             static const uint8_t eof[0x10] = {0xFF,0x07,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00};
             uint8_t buf[0x10];
-            uint8_t hdr = read_u8(offset + 0x00, sf);
+            uint8_t hdr = frame[0x00]; /* flag was read so frame is valid */
 
             int read = read_streamfile(buf, offset+0x10, sizeof(buf), sf);
             if (read > 0
@@ -309,6 +363,8 @@ static int ps_find_loop_offsets_internal(STREAMFILE *sf, off_t start_offset, siz
         }
     }
 
+    free(chunk.buf);
+
     VGM_ASSERT(loop_start_found && !loop_end_found, "PS LOOPS: found loop start but not loop end\n");
     VGM_ASSERT(loop_end_found && !loop_start_found, "PS LOOPS: found loop end but not loop start\n");
     //;VGM_LOG("PS LOOPS: start=%i, end=%i\n", loop_start, loop_end);
@@ -336,11 +392,15 @@ size_t ps_find_padding(STREAMFILE *streamFile, off_t start_offset, size_t data_s
     size_t frame_size = 0x10;
     size_t padding_size = 0;
     size_t interleave_consumed = 0;
+    ps_scan_chunk chunk = {0};
 
 
     if (data_size == 0 || channels == 0 || (channels > 0 && interleave == 0))
         return 0;
 
+    chunk.buf = malloc(PS_SCAN_CHUNK_SIZE);
+    if (!chunk.buf) return 0;
+
     offset = start_offset + data_size;
 
     /* in rare cases (ex. Gitaroo Man) channels have inconsistent empty padding, use first as guide */
@@ -349,17 +409,25 @@ size_t ps_find_padding(STREAMFILE *streamFile, off_t start_offset, size_t data_s
     /* some files have padding spanning multiple interleave blocks */
     min_offset = start_offset; //offset - interleave;
 
-    while (offset > min_offset) {
+    while (offset - min_offset >= (off_t)frame_size) {
+        uint8_t *frame;
         uint32_t f1,f2,f3,f4;
         uint8_t flag;
         int is_empty = 0;
 
         offset -= frame_size;
 
-        f1 = read_32bitBE(offset+0x00,streamFile);
-        f2 = read_32bitBE(offset+0x04,streamFile);
-        f3 = read_32bitBE(offset+0x08,streamFile);
-        f4 = read_32bitBE(offset+0x0c,streamFile);
+        frame = ps_scan_get(&chunk, streamFile, offset, frame_size, 1);
+        if (frame) {
+            f1 = get_32bitBE(frame+0x00);
+            f2 = get_32bitBE(frame+0x04);
+            f3 = get_32bitBE(frame+0x08);
+            f4 = get_32bitBE(frame+0x0c);
+        }
+        else {
+            /* failed reads count as a non-empty frame (ends the scan) */
+            f1 = f2 = f3 = f4 = 0xFFFFFFFF;
+        }
         flag = (f1 >> 16) & 0xFF;
 
         if (f1 == 0 && f2 == 0 && f3 == 0 && f4 == 0)
@@ -389,6 +457,7 @@ size_t ps_find_padding(STREAMFILE *streamFile, off_t start_offset, size_t data_s
         }
     }
 
+    free(chunk.buf);
     return padding_size;
 }
 
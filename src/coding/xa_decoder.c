@@ -48,7 +48,7 @@ static const int IK1[4] = {  0,    0,   832,   880 };
 void decode_xa(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel) {
     uint8_t frame[0x80] = {0};
     off_t frame_offset;
-    int i,j, sp_pos, frames_in, samples_done = 0, sample_count = 0;
+    int i,j, sp_pos, frames_in, samples_done = 0;
     size_t bytes_per_frame, samples_per_frame;
     int32_t hist1 = stream->adpcm_history1_32;
     int32_t hist2 = stream->adpcm_history2_32;
@@ -88,18 +88,24 @@ void decode_xa(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing,
                "bad frames at %x\n", (uint32_t)frame_offset);
 
 
-    /* decode subframes */
-    for (i = 0; i < 8 / channelspacing; i++) {
+    /* decode subframes (starting from the one with first_sample, to avoid touching hist) */
+    for (i = first_sample / 28; i < 8 / channelspacing && samples_done < samples_to_do; i++) {
         int32_t coef1, coef2;
         uint8_t coef_index, shift_factor;
+        int get_high_nibble = (channelspacing==1) ?
+                (i&1) :         /* mono (even subframes = low, off subframes = high) */
+                (channel == 1); /* stereo (L channel / even subframes = low, R channel / odd subframes = high) */
+        int su_start = (channelspacing==1) ?
+                0x10 + (i/2) :  /* mono */
+                0x10 + i;       /* stereo */
 
         /* parse current subframe (sound unit)'s header (sound parameters) */
         sp_pos = 0x04 + i*channelspacing + channel;
         coef_index   = (frame[sp_pos] >> 4) & 0xf;
         shift_factor = (frame[sp_pos] >> 0) & 0xf;
 
-        VGM_ASSERT(coef_index > 4 || shift_factor > 12, "XA: incorrect coefs/shift at %x\n", (uint32_t)frame_offset + sp_pos);
-        if (coef_index > 4)
+        VGM_ASSERT(coef_index > 3 || shift_factor > 12, "XA: incorrect coefs/shift at %x\n", (uint32_t)frame_offset + sp_pos);
+        if (coef_index > 3)
             coef_index = 0; /* only 4 filters are used, rest is apparently 0 */
         if (shift_factor > 12)
             shift_factor = 9; /* supposedly, from Nocash PSX docs */
@@ -109,24 +115,12 @@ void decode_xa(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing,
 
 
         /* decode subframe nibbles */
-        for(j = 0; j < 28; j++) {
+        j = (i == first_sample / 28) ? first_sample % 28 : 0;
+        for (; j < 28 && samples_done < samples_to_do; j++) {
             uint8_t nibbles;
             int32_t new_sample;
 
-            int su_pos = (channelspacing==1) ?
-                    0x10 + j*0x04 + (i/2) : /* mono */
-                    0x10 + j*0x04 + i;      /* stereo */
-            int get_high_nibble = (channelspacing==1) ?
-                    (i&1) :         /* mono (even subframes = low, off subframes = high) */
-                    (channel == 1); /* stereo (L channel / even subframes = low, R channel / odd subframes = high) */
-
-            /* skip half decodes to make sure hist isn't touched (kinda hack-ish) */
-            if (!(sample_count >= first_sample && samples_done < samples_to_do)) {
-                sample_count++;
-                continue;
-            }
-
-            nibbles = frame[su_pos];
+            nibbles = frame[su_start + j*0x04];
 
             new_sample = get_high_nibble ?
                     (nibbles >> 4) & 0x0f :
@@ -143,8 +137,6 @@ void decode_xa(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing,
 
             outbuf[samples_done * channelspacing] = new_sample;
             samples_done++;
-
-            sample_count++;
         }
     }
 
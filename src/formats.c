@@ -1255,7 +1255,6 @@ static const meta_info meta_info_list[] = {
 };
 
 void get_vgmstream_coding_description(VGMSTREAM *vgmstream, char *out, size_t out_size) {
-    int i, list_length;
     const char *description;
 
     /* we need to recurse down because of FFmpeg */
@@ -1280,16 +1279,24 @@ void get_vgmstream_coding_description(VGMSTREAM *vgmstream, char *out, size_t ou
             break;
 #endif
         default:
-            list_length = sizeof(coding_info_list) / sizeof(coding_info);
-            for (i = 0; i < list_length; i++) {
-                if (coding_info_list[i].type == vgmstream->coding_type)
-                    description = coding_info_list[i].description;
-            }
+            description = get_vgmstream_coding_name(vgmstream->coding_type);
+            if (!description) description = "CANNOT DECODE";
             break;
     }
 
     strncpy(out, description, out_size);
 }
+const char * get_vgmstream_coding_name(coding_t coding_type) {
+    int i, list_length;
+
+    list_length = sizeof(coding_info_list) / sizeof(coding_info);
+    for (i = 0; i < list_length; i++) {
+        if (coding_info_list[i].type == coding_type)
+            return coding_info_list[i].description;
+    }
+
+    return NULL;
+}
 const char * get_vgmstream_layout_name(layout_t layout_type) {
     int i, list_length;
 
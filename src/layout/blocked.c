@@ -2,6 +2,16 @@
 #include "../vgmstream.h"
 
 
+static int32_t get_block_samples(VGMSTREAM * vgmstream, int frame_size, int samples_per_frame) {
+    if (vgmstream->current_block_samples) {
+        return vgmstream->current_block_samples;
+    } else if (frame_size == 0) { /* assume 4 bit */ //TODO: get_vgmstream_frame_size() really should return bits... */
+        return vgmstream->current_block_size * 2 * samples_per_frame;
+    } else {
+        return vgmstream->current_block_size / frame_size * samples_per_frame;
+    }
+}
+
 /* Decodes samples for blocked streams.
  * Data is divided into headered blocks with a bunch of data. The layout calls external helper functions
  * when a block is decoded, and those must parse the new block and move offsets accordingly. */
@@ -11,15 +21,7 @@ void render_vgmstream_blocked(sample_t * buffer, int32_t sample_count, VGMSTREAM
 
     frame_size = get_vgmstream_frame_size(vgmstream);
     samples_per_frame = get_vgmstream_samples_per_frame(vgmstream);
-    samples_this_block = 0;
-
-    if (vgmstream->current_block_samples) {
-        samples_this_block = vgmstream->current_block_samples;
-    } else if (frame_size == 0) { /* assume 4 bit */ //TODO: get_vgmstream_frame_size() really should return bits... */
-        samples_this_block = vgmstream->current_block_size * 2 * samples_per_frame;
-    } else {
-        samples_this_block = vgmstream->current_block_size / frame_size * samples_per_frame;
-    }
+    samples_this_block = get_block_samples(vgmstream, frame_size, samples_per_frame);
 
 
     while (samples_written < sample_count) {
@@ -28,13 +30,7 @@ void render_vgmstream_blocked(sample_t * buffer, int32_t sample_count, VGMSTREAM
 
         if (vgmstream->loop_flag && vgmstream_do_loop(vgmstream)) {
             /* handle looping, readjust back to loop start values */
-            if (vgmstream->current_block_samples) {
-                samples_this_block = vgmstream->current_block_samples;
-            } else if (frame_size == 0) { /* assume 4 bit */ //TODO: get_vgmstream_frame_size() really should return bits... */
-                samples_this_block = vgmstream->current_block_size * 2 * samples_per_frame;
-            } else {
-                samples_this_block = vgmstream->current_block_size / frame_size * samples_per_frame;
-            }
+            samples_this_block = get_block_samples(vgmstream, frame_size, samples_per_frame);
             continue;
         }
 
@@ -57,6 +53,12 @@ void render_vgmstream_blocked(sample_t * buffer, int32_t sample_count, VGMSTREAM
             samples_to_do = sample_count - samples_written;
 
         if (samples_to_do > 0) {
+            /* read all channels' data at once (no-op if already loaded, or not using a block streamfile) */
+            if (vgmstream->next_block_offset > vgmstream->current_block_offset) {
+                load_block_streamfile(vgmstream->ch[0].streamfile, vgmstream->current_block_offset,
+                        vgmstream->next_block_offset - vgmstream->current_block_offset);
+            }
+
             /* samples_this_block = 0 is allowed (empty block, do nothing then move to next block) */
             decode_vgmstream(vgmstream, samples_written, samples_to_do, buffer);
         }
@@ -74,13 +76,7 @@ void render_vgmstream_blocked(sample_t * buffer, int32_t sample_count, VGMSTREAM
             /* update since these may change each block */
             frame_size = get_vgmstream_frame_size(vgmstream);
             samples_per_frame = get_vgmstream_samples_per_frame(vgmstream);
-            if (vgmstream->current_block_samples) {
-                samples_this_block = vgmstream->current_block_samples;
-            } else if (frame_size == 0) { /* assume 4 bit */ //TODO: get_vgmstream_frame_size() really should return bits... */
-                samples_this_block = vgmstream->current_block_size * 2 * samples_per_frame;
-            } else {
-                samples_this_block = vgmstream->current_block_size / frame_size * samples_per_frame;
-            }
+            samples_this_block = get_block_samples(vgmstream, frame_size, samples_per_frame);
 
             vgmstream->samples_into_block = 0;
         }
@@ -88,6 +84,103 @@ void render_vgmstream_blocked(sample_t * buffer, int32_t sample_count, VGMSTREAM
     }
 }
 
+/* Precomputes loop start state (loop_ch and loop block values) so players can jump to the loop without
+ * decoding from the start. Blocks are skipped by parsing headers only, then the block with the loop start
+ * is decoded up to it (plus the previous one, so codecs with history across blocks are warmed up).
+ * Only for codecs whose whole state lives in the channels. Called when the stream is set up. */
+#define LOOP_SETUP_BUFFER_SAMPLES 1024
+
+void setup_loop_blocked(VGMSTREAM * vgmstream) {
+    VGMSTREAM saved;
+    VGMSTREAMCHANNEL* saved_ch = NULL;
+    sample_t* buf = NULL;
+    size_t stream_size;
+    int32_t block_start, prev_block_start, samples_this_block, samples_to_do;
+    off_t prev_block_offset;
+
+
+    if (vgmstream->loop_ctx_ready && vgmstream->loop_sample == vgmstream->loop_start_sample)
+        return;
+    vgmstream->loop_ctx_ready = 0;
+
+    if (!vgmstream->loop_flag || !vgmstream->loop_ch || vgmstream->codec_data)
+        return;
+    if (vgmstream->current_sample != 0 || vgmstream->samples_into_block != 0 || vgmstream->hit_loop)
+        return;
+    if (vgmstream->loop_start_sample < 0 || vgmstream->loop_start_sample >= vgmstream->loop_end_sample)
+        return;
+
+    /* state is restored at the end, minus the saved loop values */
+    buf = malloc(sizeof(sample_t) * vgmstream->channels * LOOP_SETUP_BUFFER_SAMPLES);
+    if (!buf) goto fail;
+    saved_ch = malloc(sizeof(VGMSTREAMCHANNEL) * vgmstream->channels);
+    if (!saved_ch) goto fail;
+    memcpy(&saved, vgmstream, sizeof(VGMSTREAM));
+    memcpy(saved_ch, vgmstream->ch, sizeof(VGMSTREAMCHANNEL) * vgmstream->channels);
+
+    stream_size = get_streamfile_size(vgmstream->ch[0].streamfile);
+
+    /* find the block with the loop start */
+    block_start = 0;
+    prev_block_start = -1;
+    prev_block_offset = 0;
+    while (1) {
+        samples_this_block = get_block_samples(vgmstream,
+                get_vgmstream_frame_size(vgmstream), get_vgmstream_samples_per_frame(vgmstream));
+        if (samples_this_block < 0 || vgmstream->current_block_offset < 0 || vgmstream->current_block_offset >= stream_size)
+            goto fail;
+        if (block_start + samples_this_block > vgmstream->loop_start_sample)
+            break;
+        if (vgmstream->next_block_offset <= vgmstream->current_block_offset)
+            goto fail; /* would loop forever */
+
+        prev_block_start = block_start;
+        prev_block_offset = vgmstream->current_block_offset;
+        block_start += samples_this_block;
+        block_update(vgmstream->next_block_offset, vgmstream);
+    }
+
+    /* go back one block to warm up */
+    if (prev_block_start >= 0) {
+        block_update(prev_block_offset, vgmstream);
+        block_start = prev_block_start;
+    }
+    vgmstream->current_sample = block_start;
+
+    /* decode up to loop start, where vgmstream_do_loop will save the loop values */
+    while (vgmstream->current_sample < vgmstream->loop_start_sample) {
+        samples_to_do = vgmstream->loop_start_sample - vgmstream->current_sample;
+        if (samples_to_do > LOOP_SETUP_BUFFER_SAMPLES)
+            samples_to_do = LOOP_SETUP_BUFFER_SAMPLES;
+        render_vgmstream_blocked(buf, samples_to_do, vgmstream);
+    }
+    vgmstream_do_loop(vgmstream);
+    if (!vgmstream->hit_loop)
+        goto fail;
+
+    saved.loop_sample = vgmstream->loop_sample;
+    saved.loop_samples_into_block = vgmstream->loop_samples_into_block;
+    saved.loop_block_size = vgmstream->loop_block_size;
+    saved.loop_block_samples = vgmstream->loop_block_samples;
+    saved.loop_block_offset = vgmstream->loop_block_offset;
+    saved.loop_next_block_offset = vgmstream->loop_next_block_offset;
+    saved.loop_ctx_ready = 1;
+
+    memcpy(vgmstream, &saved, sizeof(VGMSTREAM));
+    memcpy(vgmstream->ch, saved_ch, sizeof(VGMSTREAMCHANNEL) * vgmstream->channels);
+    free(saved_ch);
+    free(buf);
+    return;
+
+fail:
+    if (saved_ch) {
+        memcpy(vgmstream, &saved, sizeof(VGMSTREAM));
+        memcpy(vgmstream->ch, saved_ch, sizeof(VGMSTREAMCHANNEL) * vgmstream->channels);
+    }
+    free(saved_ch);
+    free(buf);
+}
+
 /* helper functions to parse new block */
 void block_update(off_t block_offset, VGMSTREAM * vgmstream) {
     switch (vgmstream->layout_type) {
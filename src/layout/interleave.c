@@ -56,6 +56,11 @@ void render_vgmstream_interleave(sample_t * buffer, int32_t sample_count, VGMSTR
     if (samples_this_block == 0 && vgmstream->channels == 1)
         samples_this_block = vgmstream->num_samples;
 
+    /* same for PCM with 1 sample interleave (common in RIFF and such), as decoding one block per sample
+     * is very slow; channels keep their start offsets and the decoder reads all of them at once */
+    if (vgmstream_is_sample_interleaved(vgmstream))
+        samples_this_block = vgmstream->num_samples;
+
 
     /* write samples */
     while (samples_written < sample_count) {
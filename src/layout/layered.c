@@ -106,8 +106,9 @@ int setup_layout_layered(layered_layout_data* data) {
 
         if (i > 0) {
             /* a bit weird, but no matter */
-            if (data->layers[i]->sample_rate != data->layers[i-1]->sample_rate) {
-                VGM_LOG("layered: layer %i has different sample rate\n", i);
+            if (data->layers[i]->sample_rate != data->layers[0]->sample_rate) {
+                VGM_LOG("layered: layer %i has different sample rate, resampling\n", i);
+                mixing_set_resample(data->layers[i], data->layers[0]->sample_rate, VGMSTREAM_LAYOUT_RESAMPLE_QUALITY);
             }
 
             /* also weird */
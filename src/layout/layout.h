@@ -7,6 +7,7 @@
 /* blocked layouts */
 void render_vgmstream_blocked(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream);
 void block_update(off_t block_offset, VGMSTREAM * vgmstream);
+void setup_loop_blocked(VGMSTREAM * vgmstream);
 
 void block_update_ast(off_t block_ofset, VGMSTREAM * vgmstream);
 void block_update_mxch(off_t block_ofset, VGMSTREAM * vgmstream);
@@ -52,11 +53,15 @@ void render_vgmstream_interleave(sample_t * buffer, int32_t sample_count, VGMSTR
 
 void render_vgmstream_flat(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream);
 
+/* quality for layers/segments resampled to the first one's sample rate (see mixing_set_resample) */
+#define VGMSTREAM_LAYOUT_RESAMPLE_QUALITY 2
+
 void render_vgmstream_segmented(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream);
 segmented_layout_data* init_layout_segmented(int segment_count);
 int setup_layout_segmented(segmented_layout_data* data);
 void free_layout_segmented(segmented_layout_data *data);
 void reset_layout_segmented(segmented_layout_data *data);
+int prefetch_layout_segmented(segmented_layout_data *data, int enable);
 VGMSTREAM *allocate_segmented_vgmstream(segmented_layout_data* data, int loop_flag, int loop_start_segment, int loop_end_segment);
 
 void render_vgmstream_layered(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream);
@@ -5,6 +5,132 @@
 #define VGMSTREAM_MAX_SEGMENTS 1024
 #define VGMSTREAM_SEGMENT_SAMPLE_BUFFER 8192
 
+#define VGMSTREAM_SEGMENT_PREFETCH_SAMPLES 4096     /* next segment's samples decoded in advance */
+#define VGMSTREAM_SEGMENT_PREFETCH_CHUNK 1024       /* max samples decoded per render call */
+#define VGMSTREAM_SEGMENT_PREFETCH_WINDOW 32768     /* remaining samples in current segment to start */
+
+
+/* segment samples at the layout's sample rate */
+static int32_t get_segment_samples(VGMSTREAM * segment) {
+    return mixing_resampled_samples(segment, segment->num_samples);
+}
+
+/* finds loop segment and loop_start inside that segment */
+static int find_loop_segment(VGMSTREAM * vgmstream, segmented_layout_data *data, int32_t loop_sample, int32_t *p_loop_samples_skip) {
+    int loop_segment = 0;
+    int32_t total_samples = 0;
+
+    *p_loop_samples_skip = 0;
+    while (total_samples < vgmstream->num_samples && loop_segment < data->segment_count) {
+        int32_t segment_samples = get_segment_samples(data->segments[loop_segment]);
+
+        if (loop_sample >= total_samples && loop_sample < total_samples + segment_samples) {
+            *p_loop_samples_skip = loop_sample - total_samples;
+            break; /* loop_start falls within loop_segment's samples */
+        }
+        total_samples += segment_samples;
+        loop_segment++;
+    }
+
+    if (loop_segment == data->segment_count) {
+        VGM_LOG("segmented_layout: can't find loop segment\n");
+        loop_segment = 0;
+    }
+
+    return loop_segment;
+}
+
+/* Prepares the segment that plays after current one (next or loop segment) a bit every call, so the
+ * codec's reset/setup and first decodes aren't all done at the segment change. */
+static void prefetch_segment(VGMSTREAM * vgmstream, segmented_layout_data *data) {
+    VGMSTREAM *next;
+    int segment;
+    int32_t skip, remaining, samples_to_do;
+
+    /* current segment is still playing prefetched samples (buffer can't be reused yet) */
+    if (data->prefetch_segment < 0 && data->prefetch_played < data->prefetch_filled)
+        return;
+
+    /* find where playback goes after current segment */
+    remaining = get_segment_samples(data->segments[data->current_segment]) - vgmstream->samples_into_block;
+    if (vgmstream->loop_flag && vgmstream->loop_end_sample - vgmstream->current_sample <= remaining
+            && !(vgmstream->loop_target && vgmstream->loop_count + 1 == vgmstream->loop_target)) {
+        remaining = vgmstream->loop_end_sample - vgmstream->current_sample;
+        segment = find_loop_segment(vgmstream, data, vgmstream->loop_start_sample, &skip); /* loop_sample may not be set yet */
+    }
+    else {
+        segment = data->current_segment + 1;
+        skip = 0;
+        if (segment >= data->segment_count)
+            return;
+    }
+
+    if (remaining > VGMSTREAM_SEGMENT_PREFETCH_WINDOW)
+        return;
+
+    /* repeated segments use the same vgmstream, can't prepare it while playing */
+    next = data->segments[segment];
+    if (next == data->segments[data->current_segment])
+        return;
+
+    /* start new prefetch, leaving decoding for next calls */
+    if (data->prefetch_segment != segment || data->prefetch_skip != skip) {
+        data->prefetch_segment = segment;
+        data->prefetch_skip = skip;
+        data->prefetch_skipped = 0;
+        data->prefetch_filled = 0;
+        data->prefetch_played = 0;
+        reset_vgmstream(next);
+        return;
+    }
+
+    /* discard until loop start */
+    if (data->prefetch_skipped < data->prefetch_skip) {
+        samples_to_do = data->prefetch_skip - data->prefetch_skipped;
+        if (samples_to_do > VGMSTREAM_SEGMENT_PREFETCH_CHUNK)
+            samples_to_do = VGMSTREAM_SEGMENT_PREFETCH_CHUNK;
+
+        render_vgmstream(data->buffer, samples_to_do, next);
+        data->prefetch_skipped += samples_to_do;
+        return;
+    }
+
+    /* decode some samples */
+    samples_to_do = get_segment_samples(next) - data->prefetch_skip;
+    if (samples_to_do > VGMSTREAM_SEGMENT_PREFETCH_SAMPLES)
+        samples_to_do = VGMSTREAM_SEGMENT_PREFETCH_SAMPLES;
+    samples_to_do -= data->prefetch_filled;
+    if (samples_to_do > VGMSTREAM_SEGMENT_PREFETCH_CHUNK)
+        samples_to_do = VGMSTREAM_SEGMENT_PREFETCH_CHUNK;
+    if (samples_to_do <= 0)
+        return;
+
+    render_vgmstream(data->buffer, samples_to_do, next);
+    memcpy(data->prefetch_buffer + data->prefetch_filled * data->output_channels, data->buffer,
+            samples_to_do * data->output_channels * sizeof(sample_t));
+    data->prefetch_filled += samples_to_do;
+}
+
+/* Changes to a segment, using prefetched state if available. Returns samples to skip (loop start). */
+static int32_t start_segment(VGMSTREAM * vgmstream, segmented_layout_data *data, int segment, int32_t skip) {
+    int is_prefetched = data->prefetch_on && data->prefetch_segment == segment && data->prefetch_skip == skip;
+
+    data->current_segment = segment;
+    data->prefetch_segment = -1;
+    data->prefetch_played = 0;
+    data->transitions++;
+
+    if (!is_prefetched) {
+        data->prefetch_filled = 0;
+        reset_vgmstream(data->segments[segment]);
+        vgmstream->samples_into_block = 0;
+        return skip;
+    }
+
+    data->transitions_prefetched++;
+    vgmstream->samples_into_block = data->prefetch_skipped;
+    return skip - data->prefetch_skipped;
+}
 
 /* Decodes samples for segmented streams.
  * Chains together sequential vgmstreams, for data divided into separate sections or files
@@ -23,38 +149,17 @@ void render_vgmstream_segmented(sample_t * outbuf, int32_t sample_count, VGMSTRE
 
     while (samples_written < sample_count) {
         int samples_to_do;
-        int samples_this_segment = data->segments[data->current_segment]->num_samples;
+        int samples_this_segment = get_segment_samples(data->segments[data->current_segment]);
 
         if (vgmstream->loop_flag && vgmstream_do_loop(vgmstream)) {
-            int segment, loop_segment, total_samples;
+            int loop_segment;
+            int32_t loop_skip;
 
             /* handle looping by finding loop segment and loop_start inside that segment */
-            loop_segment = 0;
-            total_samples = 0;
-            while (total_samples < vgmstream->num_samples) {
-                int32_t segment_samples = data->segments[loop_segment]->num_samples;
-
-                if (vgmstream->loop_sample >= total_samples && vgmstream->loop_sample < total_samples + segment_samples) {
-                    loop_samples_skip = vgmstream->loop_sample - total_samples;
-                    break; /* loop_start falls within loop_segment's samples */
-                }
-                total_samples += segment_samples;
-                loop_segment++;
-            }
-
-            if (loop_segment == data->segment_count) {
-                VGM_LOG("segmented_layout: can't find loop segment\n");
-                loop_segment = 0;
-            }
-
-            data->current_segment = loop_segment;
+            loop_segment = find_loop_segment(vgmstream, data, vgmstream->loop_sample, &loop_skip);
 
-            /* loops can span multiple segments */
-            for (segment = loop_segment; segment < data->segment_count; segment++) {
-                reset_vgmstream(data->segments[segment]);
-            }
-
-            vgmstream->samples_into_block = 0;
+            /* loops can span multiple segments, but next ones are reset when reached */
+            loop_samples_skip = start_segment(vgmstream, data, loop_segment, loop_skip);
             continue;
         }
 
@@ -72,9 +177,23 @@ void render_vgmstream_segmented(sample_t * outbuf, int32_t sample_count, VGMSTRE
 
         /* detect segment change and restart */
         if (samples_to_do == 0) {
-            data->current_segment++;
-            reset_vgmstream(data->segments[data->current_segment]);
-            vgmstream->samples_into_block = 0;
+            start_segment(vgmstream, data, data->current_segment + 1, 0);
+            continue;
+        }
+
+        /* segment started with prefetched samples */
+        if (data->prefetch_segment < 0 && data->prefetch_played < data->prefetch_filled) {
+            if (samples_to_do > data->prefetch_filled - data->prefetch_played)
+                samples_to_do = data->prefetch_filled - data->prefetch_played;
+
+            memcpy(&outbuf[samples_written * data->output_channels],
+                    &data->prefetch_buffer[data->prefetch_played * data->output_channels],
+                    samples_to_do * data->output_channels * sizeof(sample_t));
+            data->prefetch_played += samples_to_do;
+
+            samples_written += samples_to_do;
+            vgmstream->current_sample += samples_to_do;
+            vgmstream->samples_into_block += samples_to_do;
             continue;
         }
 
@@ -102,6 +221,10 @@ void render_vgmstream_segmented(sample_t * outbuf, int32_t sample_count, VGMSTRE
         vgmstream->current_sample += samples_to_do;
         vgmstream->samples_into_block += samples_to_do;
     }
+
+    if (data->prefetch_on) {
+        prefetch_segment(vgmstream, data);
+    }
 }
 
 
@@ -116,6 +239,7 @@ segmented_layout_data* init_layout_segmented(int segment_count) {
 
     data->segment_count = segment_count;
     data->current_segment = 0;
+    data->prefetch_segment = -1;
 
     data->segments = calloc(segment_count, sizeof(VGMSTREAM*));
     if (!data->segments) goto fail;
@@ -171,8 +295,9 @@ int setup_layout_segmented(segmented_layout_data* data) {
             }
 
             /* a bit weird, but no matter */
-            if (data->segments[i]->sample_rate != data->segments[i-1]->sample_rate) {
-                VGM_LOG("segmented: segment %i has different sample rate\n", i);
+            if (data->segments[i]->sample_rate != data->segments[0]->sample_rate) {
+                VGM_LOG("segmented: segment %i has different sample rate, resampling\n", i);
+                mixing_set_resample(data->segments[i], data->segments[0]->sample_rate, VGMSTREAM_LAYOUT_RESAMPLE_QUALITY);
             }
 
             /* perfectly acceptable */
@@ -225,19 +350,35 @@ void free_layout_segmented(segmented_layout_data *data) {
         free(data->segments);
     }
     free(data->buffer);
+    free(data->prefetch_buffer);
     free(data);
 }
 
 void reset_layout_segmented(segmented_layout_data *data) {
-    int i;
 
     if (!data)
         return;
 
+    /* only the first segment needs to be ready, as render resets each segment on change */
     data->current_segment = 0;
-    for (i = 0; i < data->segment_count; i++) {
-        reset_vgmstream(data->segments[i]);
+    reset_vgmstream(data->segments[0]);
+
+    data->prefetch_segment = -1;
+    data->prefetch_filled = 0;
+    data->prefetch_played = 0;
+}
+
+int prefetch_layout_segmented(segmented_layout_data *data, int enable) {
+    if (!data)
+        return 0;
+
+    if (enable && !data->prefetch_buffer) {
+        data->prefetch_buffer = calloc(VGMSTREAM_SEGMENT_PREFETCH_SAMPLES * data->output_channels, sizeof(sample_t));
+        if (!data->prefetch_buffer) return 0;
     }
+
+    data->prefetch_on = enable;
+    return 1;
 }
 
 /* helper for easier creation of segments */
@@ -255,7 +396,7 @@ VGMSTREAM *allocate_segmented_vgmstream(segmented_layout_data* data, int loop_fl
         if (loop_flag && i == loop_start_segment)
             loop_start = num_samples;
 
-        num_samples += data->segments[i]->num_samples;
+        num_samples += get_segment_samples(data->segments[i]);
 
         if (loop_flag && i == loop_end_segment)
             loop_end = num_samples;
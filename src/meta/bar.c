@@ -4,7 +4,7 @@
 /* Guitar Hero III Mobile .bar */
 VGMSTREAM * init_vgmstream_bar(STREAMFILE *streamFile) {
     VGMSTREAM * vgmstream = NULL;
-    STREAMFILE* streamFileBAR = NULL; // don't close, this is just the source streamFile wrapped
+    STREAMFILE* streamFileBAR = NULL;
     char filename[PATH_LIMIT];
     off_t start_offset;
     off_t ch2_start_offset;
@@ -18,7 +18,7 @@ VGMSTREAM * init_vgmstream_bar(STREAMFILE *streamFile) {
     if (strcasecmp("bar",filename_extension(filename))) goto fail;
 
     /* decryption wrapper for header reading */
-    streamFileBAR = wrap_bar_STREAMFILE(streamFile);
+    streamFileBAR = setup_bar_streamfile(streamFile);
     if (!streamFileBAR) goto fail;
 
     file_size = get_streamfile_size(streamFileBAR);
@@ -65,13 +65,11 @@ VGMSTREAM * init_vgmstream_bar(STREAMFILE *streamFile) {
             vgmstream->ch[1].offset=ch2_start_offset;
     }
 
-    // discard our decrypt wrapper, without closing the original streamfile
-    free(streamFileBAR);
+    close_streamfile(streamFileBAR);
 
     return vgmstream;
 fail:
-    if (streamFileBAR)
-        free(streamFileBAR);
+    close_streamfile(streamFileBAR);
     if (vgmstream) close_vgmstream(vgmstream);
     return NULL;
 }
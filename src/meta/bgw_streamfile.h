@@ -5,43 +5,26 @@
 
 #define BGW_KEY_MAX (0xC0*2)
 
-typedef struct {
+static STREAMFILE* setup_bgw_atrac3_streamfile(STREAMFILE *streamFile, off_t subfile_offset, size_t subfile_size, size_t frame_size, int channels) {
+    STREAMFILE *temp_streamFile = NULL, *new_streamFile = NULL;
+    decrypt_streamfile_config cfg = {0};
     uint8_t key[BGW_KEY_MAX];
-    size_t key_size;
-} bgw_decryption_data;
-
-/* Encrypted ATRAC3 info from Moogle Toolbox (https://sourceforge.net/projects/mogbox/) */
-static size_t bgw_decryption_read(STREAMFILE *streamfile, uint8_t *dest, off_t offset, size_t length, bgw_decryption_data* data) {
-    size_t bytes_read;
-    int i;
-
-    bytes_read = streamfile->read(streamfile, dest, offset, length);
-
-    /* decrypt data (xor) */
-    for (i = 0; i < bytes_read; i++) {
-        dest[i] ^= data->key[(offset + i) % data->key_size];
-    }
+    int ch;
 
+    /* Encrypted ATRAC3 info from Moogle Toolbox (https://sourceforge.net/projects/mogbox/) */
     //todo: a few files (music069.bgw, music071.bgw, music900.bgw) have the last frames unencrypted,
     // though they are blank and encoder ignores wrongly decrypted frames and outputs blank samples as well
 
-    return bytes_read;
-}
-
-static STREAMFILE* setup_bgw_atrac3_streamfile(STREAMFILE *streamFile, off_t subfile_offset, size_t subfile_size, size_t frame_size, int channels) {
-    STREAMFILE *temp_streamFile = NULL, *new_streamFile = NULL;
-    bgw_decryption_data io_data = {0};
-    size_t io_data_size = sizeof(bgw_decryption_data);
-    int ch;
-
     /* setup decryption with key (first frame + modified channel header) */
     if (frame_size*channels == 0 || frame_size*channels > BGW_KEY_MAX) goto fail;
 
-    io_data.key_size = read_streamfile(io_data.key, subfile_offset, frame_size*channels, streamFile);
+    cfg.key_size = read_streamfile(key, subfile_offset, frame_size*channels, streamFile);
+    if (cfg.key_size == 0) goto fail;
     for (ch = 0; ch < channels; ch++) {
-        uint32_t xor = get_32bitBE(io_data.key + frame_size*ch);
-        put_32bitBE(io_data.key + frame_size*ch, xor ^ 0xA0024E9F);
+        uint32_t xor = get_32bitBE(key + frame_size*ch);
+        put_32bitBE(key + frame_size*ch, xor ^ 0xA0024E9F);
     }
+    cfg.key = key;
 
     /* setup subfile */
     new_streamFile = open_wrap_streamfile(streamFile);
@@ -52,7 +35,7 @@ static STREAMFILE* setup_bgw_atrac3_streamfile(STREAMFILE *streamFile, off_t sub
     if (!new_streamFile) goto fail;
     temp_streamFile = new_streamFile;
 
-    new_streamFile = open_io_streamfile(temp_streamFile, &io_data,io_data_size, bgw_decryption_read,NULL);
+    new_streamFile = open_decrypt_streamfile(temp_streamFile, &cfg);
     if (!new_streamFile) goto fail;
     temp_streamFile = new_streamFile;
 
@@ -13,30 +13,11 @@ static uint32_t swap_endian32(uint32_t v) {
 
 #define KEY_MAX_SIZE  0x1000
 
-typedef struct {
-    uint8_t key[KEY_MAX_SIZE];
-    int key_len;
-} io_data_t;
-
-static size_t io_read(STREAMFILE *sf, uint8_t *dest, off_t offset, size_t length, io_data_t *data) {
-    int i;
-    size_t bytes = read_streamfile(dest, offset, length, sf);
-
-    /* decrypt data (xor) */
-    if (offset < data->key_len) {
-        for (i = 0; i < bytes; i++) {
-            if (offset + i < data->key_len)
-                dest[i] ^= data->key[offset + i];
-        }
-    }
-
-    return bytes;
-}
-
 /* decrypts RIFF streams in NUS3BANK */
 static STREAMFILE* setup_nus3bank_streamfile(STREAMFILE *sf, off_t start) {
     STREAMFILE *new_sf = NULL;
-    io_data_t io_data = {0};
+    decrypt_streamfile_config cfg = {0};
+    uint8_t key[KEY_MAX_SIZE] = {0};
 
     /* setup key */
     {
@@ -83,9 +64,9 @@ static STREAMFILE* setup_nus3bank_streamfile(STREAMFILE *sf, off_t start) {
 
 
         /* setup key */
-        put_u32be(io_data.key + 0x00, base_key);
-        put_u32be(io_data.key + 0x04, base_key);
-        put_u32be(io_data.key + 0x08, chunk_key);
+        put_u32be(key + 0x00, base_key);
+        put_u32be(key + 0x04, base_key);
+        put_u32be(key + 0x08, chunk_key);
         pos = 0x0c; /* after WAVE */
 
         while (pos < data_pos) {
@@ -93,8 +74,8 @@ static STREAMFILE* setup_nus3bank_streamfile(STREAMFILE *sf, off_t start) {
             chunk_size = get_u32be(buf + pos + 0x04) ^ chunk_key;
             chunk_size = swap_endian32(chunk_size);
 
-            put_u32be(io_data.key + pos + 0x00, chunk_key);
-            put_u32be(io_data.key + pos + 0x04, chunk_key);
+            put_u32be(key + pos + 0x00, chunk_key);
+            put_u32be(key + pos + 0x04, chunk_key);
             pos += 0x08;
 
             if (pos >= data_pos)
@@ -106,17 +87,20 @@ static STREAMFILE* setup_nus3bank_streamfile(STREAMFILE *sf, off_t start) {
                 goto fail;
             }
 
-            memcpy(io_data.key + pos, buf + data_pos, chunk_size);
+            memcpy(key + pos, buf + data_pos, chunk_size);
 
             pos += chunk_size;
         }
 
-        io_data.key_len = data_pos;
+        /* header only (xor) */
+        cfg.end = data_pos;
+        cfg.key = key;
+        cfg.key_size = data_pos;
     }
 
 
     new_sf = open_wrap_streamfile(sf);
-    new_sf = open_io_streamfile(new_sf, &io_data, sizeof(io_data_t), io_read, NULL);
+    new_sf = open_decrypt_streamfile(new_sf, &cfg);
     return new_sf;
 fail:
     close_streamfile(sf);
@@ -11,47 +11,8 @@ typedef struct {
     int is_header_swap;
 } ogg_vorbis_io_config_data;
 
-typedef struct {
-    /* config */
-    ogg_vorbis_io_config_data cfg;
-} ogg_vorbis_io_data;
-
-
-static size_t ogg_vorbis_io_read(STREAMFILE *streamfile, uint8_t *dest, off_t offset, size_t length, ogg_vorbis_io_data* data) {
-    size_t bytes_read;
-    int i;
-    static const uint8_t header_swap[4] = { 0x4F,0x67,0x67,0x53 }; /* "OggS" */
-    static const size_t header_size = 0x04;
-
-    bytes_read = streamfile->read(streamfile, dest, offset, length);
-
-    if (data->cfg.is_encrypted) {
-        for (i = 0; i < bytes_read; i++) {
-            if (data->cfg.is_header_swap && (offset + i) < header_size) {
-                dest[i] = header_swap[(offset + i) % header_size];
-            }
-            else {
-                if (!data->cfg.key_len && !data->cfg.is_nibble_swap)
-                    break;
-                if (data->cfg.key_len)
-                    dest[i] ^= data->cfg.key[(offset + i) % data->cfg.key_len];
-                if (data->cfg.is_nibble_swap)
-                    dest[i] = ((dest[i] << 4) & 0xf0) | ((dest[i] >> 4) & 0x0f);
-            }
-        }
-    }
-
-    return bytes_read;
-}
-
-//todo maybe use generic decryption streamfile
 static STREAMFILE* setup_ogg_vorbis_streamfile(STREAMFILE *streamFile, ogg_vorbis_io_config_data cfg) {
     STREAMFILE *temp_streamFile = NULL, *new_streamFile = NULL;
-    ogg_vorbis_io_data io_data = {0};
-    size_t io_data_size = sizeof(ogg_vorbis_io_data);
-
-    /* setup decryption */
-    io_data.cfg = cfg; /* memcpy */
 
 
     /* setup custom streamfile */
@@ -61,9 +22,41 @@ static STREAMFILE* setup_ogg_vorbis_streamfile(STREAMFILE *streamFile, ogg_vorbi
 
     //todo extension .ogg?
 
-    new_streamFile = open_io_streamfile(temp_streamFile, &io_data,io_data_size, ogg_vorbis_io_read,NULL);
-    if (!new_streamFile) goto fail;
-    temp_streamFile = new_streamFile;
+    /* header replaced by "OggS" (XOR'ed with the original bytes), rest decrypted normally */
+    if (cfg.is_header_swap) {
+        static const uint8_t header_swap[4] = { 0x4F,0x67,0x67,0x53 }; /* "OggS" */
+        decrypt_streamfile_config header_cfg = {0};
+        uint8_t header_key[4];
+        int i;
+
+        if (read_streamfile(header_key, 0x00, sizeof(header_key), temp_streamFile) != sizeof(header_key))
+            goto fail;
+        for (i = 0; i < sizeof(header_key); i++) {
+            header_key[i] ^= header_swap[i];
+        }
+
+        header_cfg.end = sizeof(header_key);
+        header_cfg.key = header_key;
+        header_cfg.key_size = sizeof(header_key);
+
+        new_streamFile = open_decrypt_streamfile(temp_streamFile, &header_cfg);
+        if (!new_streamFile) goto fail;
+        temp_streamFile = new_streamFile;
+    }
+
+    if (cfg.key_len || cfg.is_nibble_swap) {
+        decrypt_streamfile_config data_cfg = {0};
+
+        data_cfg.start = cfg.is_header_swap ? 0x04 : 0x00;
+        data_cfg.key = cfg.key;
+        data_cfg.key_size = cfg.key_len;
+        data_cfg.key_start = cfg.key_len ? data_cfg.start % cfg.key_len : 0;
+        data_cfg.nibble_swap = cfg.is_nibble_swap;
+
+        new_streamFile = open_decrypt_streamfile(temp_streamFile, &data_cfg);
+        if (!new_streamFile) goto fail;
+        temp_streamFile = new_streamFile;
+    }
 
     return temp_streamFile;
 
@@ -1,6 +1,7 @@
 #include "vgmstream.h"
 #include "mixing.h"
 #include "plugins.h"
+#include "profiling.h"
 #include <math.h>
 #include <limits.h>
 
@@ -46,6 +47,11 @@
  * mixbuf if it goes first) or add function pointer indexes but isn't too important.
  * Operations are applied once per "step" with 1 sample from all channels to simplify code
  * (and maybe improve memory cache?), though maybe it should call one function per operation.
+ *
+ * Output may also be resampled to another rate after mixing (for layers/segments with
+ * different rates, or players that need a fixed rate). The resampler pulls decoded and
+ * mixed samples as needed, so vgmstream's positions and sample counts stay in the
+ * original rate, while render_vgmstream outputs samples at the new rate.
  */
 
 #define VGMSTREAM_MAX_MIXING 512
@@ -81,6 +87,35 @@ typedef struct {
     int32_t time_post;  /* position after time_end where vol_end applies (-1 = end) */
 } mix_command_data;
 
+/* Windowed-sinc polyphase resampler. The filter is precalculated for a number of phases
+ * (positions between 2 input samples), interpolating coefs between phases. */
+typedef struct {
+    int src_rate;           /* reduced by gcd */
+    int dst_rate;
+    int channels;
+    int taps;               /* input samples per output sample (even, more when downsampling) */
+    int phases;
+    float* filter;          /* phases+1 rows of taps coefs */
+    float* coefs;           /* interpolated coefs for current output sample */
+
+    float* input;           /* planar input, per channel (capacity floats each) */
+    int capacity;           /* taps + chunk */
+    int chunk;              /* max input samples rendered at once */
+    int pos;                /* current input sample (first tap) */
+    int filled;             /* valid input samples */
+    int frac;               /* position between pos and pos+1, in dst_rate units */
+    sample_t* inbuf;        /* rendered samples (input_channels) */
+} resample_data;
+
+/* Linear ops (swap/add/volume/upmix/downmix/killmix) between non-linear ones (limit/fade)
+ * are compiled into a single in*out gains matrix, so mixing is one pass per stage. */
+typedef struct {
+    int mix_index;          /* non-linear op in mixing_chain, or -1 if matrix */
+    int in_channels;        /* step channels before stage */
+    int out_channels;       /* step channels after stage */
+    float* matrix;          /* out_channels rows of in_channels gains */
+} mix_stage_data;
+
 typedef struct {
     int mixing_channels;    /* max channels needed to mix */
     int output_channels;    /* resulting channels after mixing */
@@ -89,6 +124,17 @@ typedef struct {
     size_t mixing_size;     /* mixing max */
     mix_command_data mixing_chain[VGMSTREAM_MAX_MIXING]; /* effects to apply (could be alloc'ed but to simplify...) */
     float* mixbuf;          /* internal mixing buffer */
+
+    /* chain compiled on setup */
+    mix_stage_data* stages;
+    int stage_count;
+    float* matrixbuf;       /* gains for all matrix stages */
+    float* stepbuf;         /* one sample of mixing_channels */
+
+    /* resampling after mixing */
+    int resample_rate;      /* target rate (0 = none) */
+    int resample_quality;
+    resample_data* resampler; /* created on setup */
 } mixing_data;
 
 
@@ -241,17 +287,73 @@ fail:
     return 0;
 }
 
-void mix_vgmstream(sample_t *outbuf, int32_t sample_count, VGMSTREAM* vgmstream) {
-    mixing_data *data = vgmstream->mixing_data;
-    int ch, s, m, ok;
+static void mix_apply_matrix(float *mixbuf, int stride, int32_t sample_count, mix_stage_data *stage, float *stepbuf) {
+    int s, ch_in, ch_out;
+
+    for (s = 0; s < sample_count; s++) {
+        const float *gains = stage->matrix;
+
+        for (ch_in = 0; ch_in < stage->in_channels; ch_in++) {
+            stepbuf[ch_in] = mixbuf[ch_in];
+        }
+
+        for (ch_out = 0; ch_out < stage->out_channels; ch_out++) {
+            float sample = 0.0f;
+            for (ch_in = 0; ch_in < stage->in_channels; ch_in++) {
+                sample += gains[ch_in] * stepbuf[ch_in];
+            }
+            mixbuf[ch_out] = sample;
+            gains += stage->in_channels;
+        }
 
-    int32_t current_pos, current_subpos;
-    float temp_f, temp_min, temp_max, cur_vol = 0.0f;
-    float *temp_mixbuf;
-    sample_t *temp_outbuf;
+        mixbuf += stride;
+    }
+}
 
+static void mix_apply_limit(float *mixbuf, int stride, int32_t sample_count, mix_stage_data *stage, mix_command_data *mix) {
     const float limiter_max = 32767.0f;
     const float limiter_min = -32768.0f;
+    float temp_max = limiter_max * mix->vol;
+    float temp_min = limiter_min * mix->vol;
+    int s, ch;
+    int ch_start = mix->ch_dst < 0 ? 0 : mix->ch_dst;
+    int ch_end = mix->ch_dst < 0 ? stage->in_channels : mix->ch_dst + 1;
+
+    for (s = 0; s < sample_count; s++) {
+        for (ch = ch_start; ch < ch_end; ch++) {
+            if (mixbuf[ch] > temp_max)
+                mixbuf[ch] = temp_max;
+            else if (mixbuf[ch] < temp_min)
+                mixbuf[ch] = temp_min;
+        }
+        mixbuf += stride;
+    }
+}
+
+static void mix_apply_fade(float *mixbuf, int stride, int32_t sample_count, mix_stage_data *stage, mix_command_data *mix, int32_t current_pos) {
+    float cur_vol = 0.0f;
+    int s, ch;
+    int ch_start = mix->ch_dst < 0 ? 0 : mix->ch_dst;
+    int ch_end = mix->ch_dst < 0 ? stage->in_channels : mix->ch_dst + 1;
+
+    for (s = 0; s < sample_count; s++) {
+        if (get_fade_gain(mix, &cur_vol, current_pos + s)) { /* or fade doesn't apply right now */
+            for (ch = ch_start; ch < ch_end; ch++) {
+                mixbuf[ch] = mixbuf[ch] * cur_vol;
+            }
+        }
+        mixbuf += stride;
+    }
+}
+
+void mix_vgmstream(sample_t *outbuf, int32_t sample_count, VGMSTREAM* vgmstream) {
+    mixing_data *data = vgmstream->mixing_data;
+    int ch, s, i;
+    int stride, channels;
+    int32_t current_pos;
+#ifdef VGM_PROFILING
+    uint64_t profile_time;
+#endif
 
     /* no support or not need to apply */
     if (!data || !data->mixing_on || data->mixing_count == 0)
@@ -262,136 +364,433 @@ void mix_vgmstream(sample_t *outbuf, int32_t sample_count, VGMSTREAM* vgmstream)
     if (!is_active(data, current_pos, current_pos + sample_count))
         return;
 
+#ifdef VGM_PROFILING
+    profile_time = profile_now();
+#endif
 
-    /* use advancing buffer pointers to simplify logic */
-    temp_mixbuf = data->mixbuf;
-    temp_outbuf = outbuf;
-
-    current_subpos = current_pos;
+    /* all steps use the same place in mixbuf, since channels may change between stages */
+    stride = data->mixing_channels;
+    channels = vgmstream->channels;
 
-    /* apply mixes in order per channel */
     for (s = 0; s < sample_count; s++) {
-        /* reset after new sample 'step'*/
-        float *stpbuf = temp_mixbuf;
-        int step_channels = vgmstream->channels;
+        for (ch = 0; ch < channels; ch++) {
+            data->mixbuf[s*stride + ch] = outbuf[s*channels + ch];
+        }
+    }
 
-        for (ch = 0; ch < step_channels; ch++) {
-            stpbuf[ch] = temp_outbuf[ch]; /* copy current 'lane' */
+    for (i = 0; i < data->stage_count; i++) {
+        mix_stage_data *stage = &data->stages[i];
+
+        if (stage->mix_index < 0) {
+            mix_apply_matrix(data->mixbuf, stride, sample_count, stage, data->stepbuf);
         }
+        else {
+            mix_command_data *mix = &data->mixing_chain[stage->mix_index];
+            if (mix->command == MIX_LIMIT)
+                mix_apply_limit(data->mixbuf, stride, sample_count, stage, mix);
+            else
+                mix_apply_fade(data->mixbuf, stride, sample_count, stage, mix, current_pos);
+        }
+    }
 
-        for (m = 0; m < data->mixing_count; m++) {
-            mix_command_data *mix = &data->mixing_chain[m];
-
-            /* mixing ops are designed to apply in order, all channels per 1 sample 'step'. Since some ops change
-             * total channels, channel number meaning varies as ops move them around, ex:
-             * - 4ch w/ "1-2,2+3" = ch1<>ch3, ch2(old ch1)+ch3 = 4ch: ch2 ch1+ch3 ch3 ch4
-             * - 4ch w/ "2+3,1-2" = ch2+ch3, ch1<>ch2(modified) = 4ch: ch2+ch3 ch1 ch3 ch4
-             * - 2ch w/ "1+2,1u" = ch1+ch2, ch1(add and push rest) = 3ch: ch1' ch1+ch2 ch2
-             * - 2ch w/ "1u,1+2" = ch1(add and push rest) = 3ch: ch1'+ch1 ch1 ch2
-             * - 2ch w/ "1-2,1d" = ch1<>ch2, ch1(drop and move ch2(old ch1) to ch1) = ch1
-             * - 2ch w/ "1d,1-2" = ch1(drop and pull rest), ch1(do nothing, ch2 doesn't exist now) = ch2
+    /* copy resulting mix to output */
+    channels = data->output_channels;
+    for (s = 0; s < sample_count; s++) {
+        for (ch = 0; ch < channels; ch++) {
+            /* when casting float to int, value is simply truncated:
+             * - (int)1.7 = 1, (int)-1.7 = -1
+             * alts for more accurate rounding could be:
+             * - (int)floor(f)
+             * - (int)(f < 0 ? f - 0.5f : f + 0.5f)
+             * - (((int) (f1 + 32768.5)) - 32768)
+             * - etc
+             * but since +-1 isn't really audible we'll just cast as it's the fastest
              */
-            switch(mix->command) {
+            outbuf[s*channels + ch] = clamp16( (int32_t)data->mixbuf[s*stride + ch] );
+        }
+    }
+
+#ifdef VGM_PROFILING
+    profile_add_mixing(profile_time, sample_count);
+#endif
+}
+
+/* Transforms the mixing chain into stages. Linear ops modify a gains matrix as they would modify
+ * one sample step, where each row is an output channel made of the stage's input channels. */
+static int mixing_compile(VGMSTREAM* vgmstream) {
+    mixing_data *data = vgmstream->mixing_data;
+    int max_channels = data->mixing_channels;
+    size_t matrix_size = max_channels * max_channels;
+    float *gains, *temp_row;
+    int m, ch, step_channels, stage_channels, is_identity;
+
+    free(data->stages);
+    free(data->matrixbuf);
+    free(data->stepbuf);
+    data->stages = NULL;
+    data->matrixbuf = NULL;
+    data->stepbuf = NULL;
+    data->stage_count = 0;
+
+    /* worst case is matrix + op for every op, plus one extra row to swap */
+    data->stages = calloc(data->mixing_count * 2 + 1, sizeof(mix_stage_data));
+    data->matrixbuf = calloc((data->mixing_count + 1) * matrix_size + max_channels, sizeof(float));
+    data->stepbuf = calloc(max_channels, sizeof(float));
+    if (!data->stages || !data->matrixbuf || !data->stepbuf) goto fail;
+
+    temp_row = data->matrixbuf + (data->mixing_count + 1) * matrix_size;
+    gains = data->matrixbuf;
+    step_channels = vgmstream->channels;
+    stage_channels = step_channels;
+    is_identity = 1;
+    for (ch = 0; ch < step_channels; ch++) {
+        gains[ch*stage_channels + ch] = 1.0f;
+    }
 
+    for (m = 0; m <= data->mixing_count; m++) {
+        mix_command_data *mix = (m < data->mixing_count) ? &data->mixing_chain[m] : NULL;
+
+        /* mixing ops are designed to apply in order, all channels per 1 sample 'step'. Since some ops change
+         * total channels, channel number meaning varies as ops move them around, ex:
+         * - 4ch w/ "1-2,2+3" = ch1<>ch3, ch2(old ch1)+ch3 = 4ch: ch2 ch1+ch3 ch3 ch4
+         * - 4ch w/ "2+3,1-2" = ch2+ch3, ch1<>ch2(modified) = 4ch: ch2+ch3 ch1 ch3 ch4
+         * - 2ch w/ "1+2,1u" = ch1+ch2, ch1(add and push rest) = 3ch: ch1' ch1+ch2 ch2
+         * - 2ch w/ "1u,1+2" = ch1(add and push rest) = 3ch: ch1'+ch1 ch1 ch2
+         * - 2ch w/ "1-2,1d" = ch1<>ch2, ch1(drop and move ch2(old ch1) to ch1) = ch1
+         * - 2ch w/ "1d,1-2" = ch1(drop and pull rest), ch1(do nothing, ch2 doesn't exist now) = ch2
+         */
+        if (mix && mix->command != MIX_LIMIT && mix->command != MIX_FADE) {
+            float *row_dst = gains + mix->ch_dst * stage_channels;
+            float *row_src = gains + mix->ch_src * stage_channels;
+
+            switch(mix->command) {
                 case MIX_SWAP:
-                    temp_f = stpbuf[mix->ch_dst];
-                    stpbuf[mix->ch_dst] = stpbuf[mix->ch_src];
-                    stpbuf[mix->ch_src] = temp_f;
+                    memcpy(temp_row, row_dst, stage_channels * sizeof(float));
+                    memcpy(row_dst, row_src, stage_channels * sizeof(float));
+                    memcpy(row_src, temp_row, stage_channels * sizeof(float));
                     break;
 
                 case MIX_ADD:
-                    stpbuf[mix->ch_dst] = stpbuf[mix->ch_dst] + stpbuf[mix->ch_src] * mix->vol;
+                    for (ch = 0; ch < stage_channels; ch++) {
+                        row_dst[ch] = row_dst[ch] + row_src[ch] * mix->vol;
+                    }
                     break;
 
                 case MIX_VOLUME:
                     if (mix->ch_dst < 0) {
-                        for (ch = 0; ch < step_channels; ch++) {
-                            stpbuf[ch] = stpbuf[ch] * mix->vol;
+                        for (ch = 0; ch < step_channels * stage_channels; ch++) {
+                            gains[ch] = gains[ch] * mix->vol;
                         }
                     }
                     else {
-                        stpbuf[mix->ch_dst] = stpbuf[mix->ch_dst] * mix->vol;
-                    }
-                    break;
-
-                case MIX_LIMIT:
-                    temp_max = limiter_max * mix->vol;
-                    temp_min = limiter_min * mix->vol;
-
-                    if (mix->ch_dst < 0) {
-                        for (ch = 0; ch < step_channels; ch++) {
-                            if (stpbuf[ch] > temp_max)
-                                stpbuf[ch] = temp_max;
-                            else if (stpbuf[ch] < temp_min)
-                                stpbuf[ch] = temp_min;
+                        for (ch = 0; ch < stage_channels; ch++) {
+                            row_dst[ch] = row_dst[ch] * mix->vol;
                         }
                     }
-                    else {
-                        if (stpbuf[mix->ch_dst] > temp_max)
-                            stpbuf[mix->ch_dst] = temp_max;
-                        else if (stpbuf[mix->ch_dst] < temp_min)
-                            stpbuf[mix->ch_dst] = temp_min;
-                    }
                     break;
 
-                case MIX_UPMIX:
+                case MIX_UPMIX: /* 'push' channels forward (or pull backwards), inserted as silent */
+                    memmove(row_dst + stage_channels, row_dst, (step_channels - mix->ch_dst) * stage_channels * sizeof(float));
+                    memset(row_dst, 0, stage_channels * sizeof(float));
                     step_channels += 1;
-                    for (ch = step_channels - 1; ch > mix->ch_dst; ch--) {
-                        stpbuf[ch] = stpbuf[ch-1]; /* 'push' channels forward (or pull backwards) */
-                    }
-                    stpbuf[mix->ch_dst] = 0; /* inserted as silent */
                     break;
 
-                case MIX_DOWNMIX:
+                case MIX_DOWNMIX: /* 'pull' channels back */
                     step_channels -= 1;
-                    for (ch = mix->ch_dst; ch < step_channels; ch++) {
-                        stpbuf[ch] = stpbuf[ch+1]; /* 'pull' channels back */
-                    }
+                    memmove(row_dst, row_dst + stage_channels, (step_channels - mix->ch_dst) * stage_channels * sizeof(float));
                     break;
 
-                case MIX_KILLMIX:
-                    step_channels = mix->ch_dst; /* clamp channels */
-                    break;
-
-                case MIX_FADE:
-                    ok = get_fade_gain(mix, &cur_vol, current_subpos);
-                    if (!ok) {
-                        break; /* fade doesn't apply right now */
-                    }
-
-                    if (mix->ch_dst < 0) {
-                        for (ch = 0; ch < step_channels; ch++) {
-                            stpbuf[ch] = stpbuf[ch] * cur_vol;
-                        }
-                    }
-                    else {
-                        stpbuf[mix->ch_dst] = stpbuf[mix->ch_dst] * cur_vol;
-                    }
+                case MIX_KILLMIX: /* clamp channels */
+                    step_channels = mix->ch_dst;
                     break;
 
                 default:
                     break;
             }
+
+            is_identity = 0;
+            continue;
+        }
+
+        /* close current matrix (if it does anything) */
+        if (!is_identity) {
+            mix_stage_data *stage = &data->stages[data->stage_count];
+            stage->mix_index = -1;
+            stage->in_channels = stage_channels;
+            stage->out_channels = step_channels;
+            stage->matrix = gains;
+            data->stage_count++;
+
+            gains += matrix_size;
         }
 
-        current_subpos++;
+        if (!mix)
+            break;
 
-        temp_mixbuf += step_channels;
-        temp_outbuf += vgmstream->channels;
+        /* add non-linear op and start a new matrix */
+        {
+            mix_stage_data *stage = &data->stages[data->stage_count];
+            stage->mix_index = m;
+            stage->in_channels = step_channels;
+            stage->out_channels = step_channels;
+            data->stage_count++;
+        }
+
+        stage_channels = step_channels;
+        is_identity = 1;
+        memset(gains, 0, matrix_size * sizeof(float));
+        for (ch = 0; ch < step_channels; ch++) {
+            gains[ch*stage_channels + ch] = 1.0f;
+        }
     }
 
-    /* copy resulting mix to output */
-    for (s = 0; s < sample_count * data->output_channels; s++) {
-        /* when casting float to int, value is simply truncated:
-         * - (int)1.7 = 1, (int)-1.7 = -1
-         * alts for more accurate rounding could be:
-         * - (int)floor(f)
-         * - (int)(f < 0 ? f - 0.5f : f + 0.5f)
-         * - (((int) (f1 + 32768.5)) - 32768)
-         * - etc
-         * but since +-1 isn't really audible we'll just cast as it's the fastest
-         */
-        outbuf[s] = clamp16( (int32_t)data->mixbuf[s] );
+    return 1;
+fail:
+    return 0;
+}
+
+/* ******************************************************************* */
+
+#define RESAMPLE_CHUNK 1024
+#define RESAMPLE_MAX_TAPS 2048   /* filter length cap for huge downsampling ratios */
+
+static const struct {
+    int taps;
+    int phases;
+    float beta;         /* Kaiser window shape (higher = more stopband attenuation, wider transition) */
+    float bandwidth;    /* passband vs output's nyquist */
+} resample_qualities[] = {
+        {  8,  32,  5.0f, 0.80f },
+        { 16,  64,  6.0f, 0.88f },
+        { 32, 128,  8.0f, 0.92f },
+        { 64, 256, 10.0f, 0.95f },
+};
+
+/* modified Bessel function of the first kind, order 0 (for Kaiser windows) */
+static double bessel_i0(double x) {
+    double sum = 1.0, term = 1.0, half_x = x / 2.0;
+    int k;
+
+    for (k = 1; k < 32; k++) {
+        term *= (half_x / k) * (half_x / k);
+        sum += term;
+        if (term < sum * 1e-12)
+            break;
+    }
+    return sum;
+}
+
+static int get_gcd(int a, int b) {
+    while (b) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static void resampler_close(resample_data* rs) {
+    if (!rs) return;
+    free(rs->filter);
+    free(rs->coefs);
+    free(rs->input);
+    free(rs->inbuf);
+    free(rs);
+}
+
+static void resampler_reset(resample_data* rs) {
+    /* starts with taps/2-1 silent samples before the first one, so output is centered */
+    memset(rs->input, 0, rs->capacity * rs->channels * sizeof(float));
+    rs->pos = 0;
+    rs->filled = rs->taps / 2 - 1;
+    rs->frac = 0;
+}
+
+static resample_data* resampler_init(int src_rate, int dst_rate, int channels, int input_channels, int quality, int chunk) {
+    resample_data* rs = NULL;
+    int gcd, taps, phases, p, j;
+    double cutoff, beta, i0_beta;
+
+    if (quality < 0)
+        quality = 0;
+    if (quality >= sizeof(resample_qualities) / sizeof(resample_qualities[0]))
+        quality = sizeof(resample_qualities) / sizeof(resample_qualities[0]) - 1;
+
+    rs = calloc(1, sizeof(resample_data));
+    if (!rs) goto fail;
+
+    /* when downsampling the filter is stretched to output's rate (see below), so it needs more taps
+     * to cover the same output samples (capped, though ratios that big are rather unlikely) */
+    taps = resample_qualities[quality].taps;
+    if (dst_rate < src_rate) {
+        int ratio = (src_rate + dst_rate - 1) / dst_rate;
+        if (ratio > RESAMPLE_MAX_TAPS / taps)
+            taps = RESAMPLE_MAX_TAPS;
+        else
+            taps = taps * ratio;
+    }
+
+    gcd = get_gcd(src_rate, dst_rate);
+    phases = resample_qualities[quality].phases;
+
+    rs->src_rate = src_rate / gcd;
+    rs->dst_rate = dst_rate / gcd;
+    rs->channels = channels;
+    rs->taps = taps;
+    rs->phases = phases;
+    rs->chunk = chunk;
+    rs->capacity = taps + chunk;
+
+    rs->filter = malloc((phases + 1) * taps * sizeof(float));
+    rs->coefs = malloc(taps * sizeof(float));
+    rs->input = malloc(rs->capacity * channels * sizeof(float));
+    rs->inbuf = malloc(chunk * input_channels * sizeof(sample_t));
+    if (!rs->filter || !rs->coefs || !rs->input || !rs->inbuf) goto fail;
+
+    /* lowpass below the lowest nyquist (when downsampling the filter is stretched to output's rate) */
+    cutoff = resample_qualities[quality].bandwidth;
+    if (dst_rate < src_rate)
+        cutoff = cutoff * dst_rate / src_rate;
+    beta = resample_qualities[quality].beta;
+    i0_beta = bessel_i0(beta);
+
+    for (p = 0; p <= phases; p++) {
+        float* row = &rs->filter[p * taps];
+        double sum = 0.0;
+
+        for (j = 0; j < taps; j++) {
+            /* distance from output position to tap's input sample */
+            double x = (double)(j - taps / 2 + 1) - (double)p / phases;
+            double w = x / (taps / 2);
+            double h;
+
+            if (w <= -1.0 || w >= 1.0) {
+                h = 0.0;
+            }
+            else {
+                double sinc = (x == 0.0) ? 1.0 : sin(MIXING_PI * cutoff * x) / (MIXING_PI * cutoff * x);
+                h = cutoff * sinc * bessel_i0(beta * sqrt(1.0 - w * w)) / i0_beta;
+            }
+
+            row[j] = (float)h;
+            sum += h;
+        }
+
+        /* unity gain in every phase */
+        for (j = 0; j < taps; j++) {
+            row[j] = (float)(row[j] / sum);
+        }
+    }
+
+    resampler_reset(rs);
+    return rs;
+fail:
+    resampler_close(rs);
+    return NULL;
+}
+
+/* renders up to samples_to_do into inbuf, returning valid samples (less past the stream's end) */
+static int resampler_render(resample_data* rs, VGMSTREAM* vgmstream, int samples_to_do) {
+    if (!vgmstream->loop_flag) {
+        int32_t samples_left = vgmstream->num_samples - vgmstream->current_sample;
+        if (samples_left < 0)
+            samples_left = 0;
+        if (samples_to_do > samples_left)
+            samples_to_do = samples_left;
+    }
+
+    if (samples_to_do > 0) {
+        render_vgmstream_internal(rs->inbuf, samples_to_do, vgmstream);
+    }
+    return samples_to_do;
+}
+
+/* moves remaining input to the start and renders more, or silence past the stream's end */
+static void resampler_fill(resample_data* rs, VGMSTREAM* vgmstream) {
+    int ch, s, keep, samples_to_do, samples_done;
+
+    if (rs->pos > rs->filled) {
+        /* position may jump over unloaded samples when taps are capped, drop them */
+        int skip = rs->pos - rs->filled;
+        while (skip > 0) {
+            samples_to_do = skip > rs->chunk ? rs->chunk : skip;
+            resampler_render(rs, vgmstream, samples_to_do);
+            skip -= samples_to_do;
+        }
+        keep = 0;
+    }
+    else {
+        keep = rs->filled - rs->pos;
+        for (ch = 0; ch < rs->channels; ch++) {
+            float* input = &rs->input[ch * rs->capacity];
+            memmove(input, input + rs->pos, keep * sizeof(float));
+        }
+    }
+    rs->filled = keep;
+    rs->pos = 0;
+
+    samples_to_do = rs->capacity - rs->filled;
+    if (samples_to_do > rs->chunk)
+        samples_to_do = rs->chunk;
+
+    samples_done = resampler_render(rs, vgmstream, samples_to_do);
+
+    for (ch = 0; ch < rs->channels; ch++) {
+        float* input = &rs->input[ch * rs->capacity + rs->filled];
+        for (s = 0; s < samples_done; s++) {
+            input[s] = rs->inbuf[s * rs->channels + ch];
+        }
+        for (s = samples_done; s < samples_to_do; s++) {
+            input[s] = 0.0f;
+        }
+    }
+
+    rs->filled += samples_to_do;
+}
+
+void resample_vgmstream(sample_t *outbuf, int32_t sample_count, VGMSTREAM* vgmstream) {
+    mixing_data *data = vgmstream->mixing_data;
+    resample_data* rs = data->resampler;
+    const int taps = rs->taps;
+    int ch, s, j;
+
+    for (s = 0; s < sample_count; s++) {
+        float phase, mu;
+        int phase_index;
+        const float *row0, *row1;
+
+        /* big downsampling ratios may need more than one fill */
+        while (rs->pos + taps > rs->filled) {
+            resampler_fill(rs, vgmstream);
+        }
+
+        /* coefs for this output position */
+        phase = (float)rs->frac * rs->phases / rs->dst_rate;
+        phase_index = (int)phase;
+        mu = phase - phase_index;
+        row0 = &rs->filter[phase_index * taps];
+        row1 = row0 + taps;
+        for (j = 0; j < taps; j++) {
+            rs->coefs[j] = row0[j] + (row1[j] - row0[j]) * mu;
+        }
+
+        for (ch = 0; ch < rs->channels; ch++) {
+            const float* input = &rs->input[ch * rs->capacity + rs->pos];
+            float sample = 0.0f;
+
+            for (j = 0; j < taps; j++) {
+                sample += input[j] * rs->coefs[j];
+            }
+
+            outbuf[s * rs->channels + ch] = clamp16( (int32_t)sample );
+        }
+
+        /* advance src/dst input samples */
+        rs->frac += rs->src_rate;
+        while (rs->frac >= rs->dst_rate) {
+            rs->frac -= rs->dst_rate;
+            rs->pos++;
+        }
     }
 }
 
@@ -413,6 +812,21 @@ fail:
     return;
 }
 
+void mixing_copy(VGMSTREAM* vgmstream, VGMSTREAM* source) {
+    mixing_data *data = vgmstream->mixing_data;
+    mixing_data *data_src = source->mixing_data;
+
+    if (!data || !data_src || data->mixing_on)
+        return;
+    if (vgmstream->channels != source->channels)
+        return;
+
+    data->mixing_channels = data_src->mixing_channels;
+    data->output_channels = data_src->output_channels;
+    data->mixing_count = data_src->mixing_count;
+    memcpy(data->mixing_chain, data_src->mixing_chain, sizeof(mix_command_data) * data_src->mixing_count);
+}
+
 void mixing_close(VGMSTREAM* vgmstream) {
     mixing_data *data = NULL;
     if (!vgmstream) return;
@@ -421,9 +835,20 @@ void mixing_close(VGMSTREAM* vgmstream) {
     if (!data) return;
 
     free(data->mixbuf);
+    free(data->stages);
+    free(data->matrixbuf);
+    free(data->stepbuf);
+    resampler_close(data->resampler);
     free(data);
 }
 
+void mixing_reset(VGMSTREAM* vgmstream) {
+    mixing_data *data = vgmstream->mixing_data;
+    if (!data || !data->resampler) return;
+
+    resampler_reset(data->resampler);
+}
+
 void mixing_update_channel(VGMSTREAM* vgmstream) {
     mixing_data *data = vgmstream->mixing_data;
     if (!data) return;
@@ -1077,6 +1502,22 @@ void mixing_setup(VGMSTREAM * vgmstream, int32_t max_sample_count) {
     if (!mixbuf_re) goto fail;
 
     data->mixbuf = mixbuf_re;
+
+    if (!mixing_compile(vgmstream))
+        goto fail;
+
+    resampler_close(data->resampler);
+    data->resampler = NULL;
+    if (data->resample_rate && data->resample_rate != vgmstream->sample_rate && vgmstream->sample_rate > 0) {
+        int input_channels = vgmstream->channels;
+        int chunk = max_sample_count < RESAMPLE_CHUNK ? max_sample_count : RESAMPLE_CHUNK;
+
+        mixing_info(vgmstream, &input_channels, NULL);
+        data->resampler = resampler_init(vgmstream->sample_rate, data->resample_rate,
+                data->output_channels, input_channels, data->resample_quality, chunk);
+        if (!data->resampler) goto fail;
+    }
+
     data->mixing_on = 1;
 
     /* since data exists on its own memory and pointer is already set
@@ -1109,3 +1550,54 @@ void mixing_info(VGMSTREAM * vgmstream, int *out_input_channels, int *out_output
 fail:
     return;
 }
+
+int mixing_is_enabled(VGMSTREAM * vgmstream) {
+    mixing_data *data = vgmstream->mixing_data;
+
+    return data && data->mixing_on;
+}
+
+int mixing_has_fades(VGMSTREAM * vgmstream) {
+    mixing_data *data = vgmstream->mixing_data;
+    int i;
+
+    if (!data)
+        return 0;
+
+    for (i = 0; i < data->mixing_count; i++) {
+        if (data->mixing_chain[i].command == MIX_FADE)
+            return 1;
+    }
+
+    return 0;
+}
+
+void mixing_set_resample(VGMSTREAM* vgmstream, int sample_rate, int quality) {
+    mixing_data *data = vgmstream->mixing_data;
+
+    if (!data || sample_rate < 0) return;
+    if (data->mixing_on) {
+        VGM_LOG("MIX: ignoring resample when mixing active\n");
+        return;
+    }
+
+    data->resample_rate = sample_rate;
+    data->resample_quality = quality;
+}
+
+int mixing_is_resampling(VGMSTREAM * vgmstream) {
+    mixing_data *data = vgmstream->mixing_data;
+
+    return data && data->resampler;
+}
+
+int32_t mixing_resampled_samples(VGMSTREAM * vgmstream, int32_t samples) {
+    mixing_data *data = vgmstream->mixing_data;
+    int rate;
+
+    if (!data || !data->resample_rate || data->resample_rate == vgmstream->sample_rate || vgmstream->sample_rate <= 0)
+        return samples;
+
+    rate = data->resample_rate;
+    return (int32_t)(((int64_t)samples * rate + vgmstream->sample_rate / 2) / vgmstream->sample_rate);
+}
@@ -7,11 +7,19 @@
  * outbuf must big enough to hold output_channels*samples_to_do */
 void mix_vgmstream(sample_t *outbuf, int32_t sample_count, VGMSTREAM* vgmstream);
 
+/* Renders samples resampled to the rate set with mixing_set_resample (pulling decoded and mixed samples
+ * as needed). Resampling must be active and outbuf big enough to hold input_channels*samples_to_do */
+void resample_vgmstream(sample_t *outbuf, int32_t sample_count, VGMSTREAM* vgmstream);
+
 /* internal mixing pre-setup for vgmstream (doesn't imply usage).
  * If init somehow fails next calls are ignored. */
 void mixing_init(VGMSTREAM* vgmstream);
 void mixing_close(VGMSTREAM* vgmstream);
 void mixing_update_channel(VGMSTREAM* vgmstream);
+void mixing_reset(VGMSTREAM* vgmstream);
+
+/* copies mixes (not enabled) from another vgmstream with the same channels, for independent copies of a stream */
+void mixing_copy(VGMSTREAM* vgmstream, VGMSTREAM* source);
 
 /* Call to let vgmstream apply mixing, which must handle input/output_channels.
  * Once mixing is active any new mixes are ignored (to avoid the possibility
@@ -21,6 +29,21 @@ void mixing_setup(VGMSTREAM * vgmstream, int32_t max_sample_count);
 /* gets current mixing info */
 void mixing_info(VGMSTREAM * vgmstream, int *input_channels, int *output_channels);
 
+/* returns if mixing was enabled (render outputs output_channels) */
+int mixing_is_enabled(VGMSTREAM * vgmstream);
+
+/* returns if mixing has fades, so output depends on play position and not just decoded samples */
+int mixing_has_fades(VGMSTREAM * vgmstream);
+
+/* sets resampling to sample_rate after mixing, applied once mixing is enabled (quality 0..3, higher is slower) */
+void mixing_set_resample(VGMSTREAM* vgmstream, int sample_rate, int quality);
+
+/* returns if output is resampled (render_vgmstream then outputs at the new rate) */
+int mixing_is_resampling(VGMSTREAM * vgmstream);
+
+/* converts samples to the resampled rate (or returns the same value if not resampling) */
+int32_t mixing_resampled_samples(VGMSTREAM * vgmstream, int32_t samples);
+
 /* adds mixes filtering and optimizing if needed */
 void mixing_push_swap(VGMSTREAM* vgmstream, int ch_dst, int ch_src);
 void mixing_push_add(VGMSTREAM* vgmstream, int ch_dst, int ch_src, double volume);
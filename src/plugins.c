@@ -1,3 +1,4 @@
+#include <sys/stat.h>
 #include "vgmstream.h"
 #include "plugins.h"
 #include "mixing.h"
@@ -7,7 +8,7 @@
 /* CONTEXT: simplifies plugin code            */
 /* ****************************************** */
 
-int vgmstream_ctx_is_valid(const char* filename, vgmstream_ctx_valid_cfg *cfg) {
+static int ctx_is_valid_extension(const char* filename, vgmstream_ctx_valid_cfg *cfg) {
     const char ** extension_list;
     size_t extension_list_len;
     const char *extension;
@@ -63,6 +64,17 @@ int vgmstream_ctx_is_valid(const char* filename, vgmstream_ctx_valid_cfg *cfg) {
     return 0;
 }
 
+int vgmstream_ctx_is_valid(const char* filename, vgmstream_ctx_valid_cfg *cfg) {
+    if (!ctx_is_valid_extension(filename, cfg))
+        return 0;
+
+    /* files that failed before are rejected without probing (checked last as it needs to stat the file) */
+    if (cfg->negcache && !cfg->is_extension && vgmstream_negcache_is_rejected(cfg->negcache, filename))
+        return 0;
+
+    return 1;
+}
+
 /* ****************************************** */
 /* TAGS: loads key=val tags from a file       */
 /* ****************************************** */
@@ -331,6 +343,14 @@ void vgmstream_mixing_enable(VGMSTREAM* vgmstream, int32_t max_sample_count, int
     mixing_info(vgmstream, input_channels, output_channels);
 }
 
+void vgmstream_mixing_resample(VGMSTREAM* vgmstream, int sample_rate, int quality) {
+    mixing_set_resample(vgmstream, sample_rate, quality);
+}
+
+int32_t vgmstream_mixing_resampled_samples(VGMSTREAM* vgmstream, int32_t samples) {
+    return mixing_resampled_samples(vgmstream, samples);
+}
+
 void vgmstream_mixing_autodownmix(VGMSTREAM *vgmstream, int max_channels) {
     if (max_channels <= 0)
         return;
@@ -346,3 +366,623 @@ void vgmstream_mixing_autodownmix(VGMSTREAM *vgmstream, int max_channels) {
 
     return;
 }
+
+
+/* ****************************************** */
+/* PCMCACHE: reuses decoded samples           */
+/* ****************************************** */
+
+struct VGMSTREAM_PCMCACHE_ENTRY {
+    char* filename;
+    int subsong;
+    char* config;
+
+    sample_t* samples;
+    size_t samples_bytes;
+    vgmstream_pcmcache_info info;
+
+    int refs;
+    int detached;           /* removed from cache, freed on last release */
+    uint32_t last_used;
+};
+
+struct VGMSTREAM_PCMCACHE {
+    size_t max_bytes;
+    size_t max_entry_bytes;
+
+    VGMSTREAM_PCMCACHE_ENTRY** entries;
+    int entries_count;
+    int entries_max;
+    uint32_t use_counter;   /* for LRU */
+
+    vgmstream_pcmcache_stats stats;
+};
+
+
+static void pcmcache_free_entry(VGMSTREAM_PCMCACHE_ENTRY* entry) {
+    if (!entry) return;
+    free(entry->filename);
+    free(entry->config);
+    free(entry->samples);
+    free(entry);
+}
+
+static void pcmcache_remove_entry(VGMSTREAM_PCMCACHE* cache, int index) {
+    VGMSTREAM_PCMCACHE_ENTRY* entry = cache->entries[index];
+
+    cache->stats.resident_bytes -= entry->samples_bytes;
+    cache->entries[index] = cache->entries[cache->entries_count - 1];
+    cache->entries_count--;
+
+    if (entry->refs > 0)
+        entry->detached = 1;
+    else
+        pcmcache_free_entry(entry);
+}
+
+/* evicts least recently used entries until new_bytes fit */
+static void pcmcache_evict(VGMSTREAM_PCMCACHE* cache, size_t new_bytes) {
+    while (cache->entries_count > 0 && cache->stats.resident_bytes + new_bytes > cache->max_bytes) {
+        int i, lru = 0;
+
+        for (i = 1; i < cache->entries_count; i++) {
+            if ((int32_t)(cache->entries[i]->last_used - cache->entries[lru]->last_used) < 0)
+                lru = i;
+        }
+
+        pcmcache_remove_entry(cache, lru);
+        cache->stats.evictions++;
+    }
+}
+
+static char* pcmcache_strdup(const char* str) {
+    size_t len = strlen(str) + 1;
+    char* dup = malloc(len);
+    if (dup) memcpy(dup, str, len);
+    return dup;
+}
+
+static VGMSTREAM_PCMCACHE_ENTRY* pcmcache_find(VGMSTREAM_PCMCACHE* cache, const char* filename, int subsong, const char* config) {
+    int i;
+
+    if (!config) config = "";
+    for (i = 0; i < cache->entries_count; i++) {
+        VGMSTREAM_PCMCACHE_ENTRY* entry = cache->entries[i];
+        if (entry->subsong == subsong && strcmp(entry->filename, filename) == 0 && strcmp(entry->config, config) == 0) {
+            entry->refs++;
+            entry->last_used = ++cache->use_counter;
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+VGMSTREAM_PCMCACHE* vgmstream_pcmcache_init(size_t max_bytes, size_t max_entry_bytes) {
+    VGMSTREAM_PCMCACHE* cache = NULL;
+
+    cache = calloc(1, sizeof(VGMSTREAM_PCMCACHE));
+    if (!cache) goto fail;
+
+    cache->max_bytes = max_bytes;
+    cache->max_entry_bytes = max_entry_bytes > max_bytes ? max_bytes : max_entry_bytes;
+
+    return cache;
+fail:
+    return NULL;
+}
+
+void vgmstream_pcmcache_close(VGMSTREAM_PCMCACHE* cache) {
+    if (!cache) return;
+
+    while (cache->entries_count > 0) {
+        pcmcache_remove_entry(cache, cache->entries_count - 1);
+    }
+    free(cache->entries);
+    free(cache);
+}
+
+VGMSTREAM_PCMCACHE_ENTRY* vgmstream_pcmcache_get(VGMSTREAM_PCMCACHE* cache, const char* filename, int subsong, const char* config) {
+    VGMSTREAM_PCMCACHE_ENTRY* entry;
+
+    if (!cache || !filename)
+        return NULL;
+
+    entry = pcmcache_find(cache, filename, subsong, config);
+    if (entry)
+        cache->stats.hits++;
+    else
+        cache->stats.misses++;
+    return entry;
+}
+
+VGMSTREAM_PCMCACHE_ENTRY* vgmstream_pcmcache_add(VGMSTREAM_PCMCACHE* cache, const char* filename, int subsong, const char* config,
+        VGMSTREAM* vgmstream, int32_t buffer_samples) {
+    VGMSTREAM_PCMCACHE_ENTRY* entry = NULL;
+    sample_t* buf = NULL;
+    int input_channels, output_channels;
+    int32_t num_samples, decoded;
+    size_t bytes;
+
+
+    if (!cache || !filename || !vgmstream || buffer_samples <= 0)
+        return NULL;
+
+    /* may be added by another player in the meantime */
+    entry = pcmcache_find(cache, filename, subsong, config);
+    if (entry)
+        return entry;
+
+    /* output must only depend on decoded samples */
+    input_channels = output_channels = vgmstream->channels;
+    if (mixing_is_enabled(vgmstream))
+        mixing_info(vgmstream, &input_channels, &output_channels);
+    if (mixing_has_fades(vgmstream) || mixing_is_resampling(vgmstream)) /* resampled loops aren't exact */
+        goto reject;
+
+    num_samples = vgmstream->num_samples;
+    if (num_samples <= 0 || output_channels <= 0)
+        goto reject;
+    if (vgmstream->loop_flag && (vgmstream->loop_start_sample < 0 ||
+            vgmstream->loop_start_sample >= vgmstream->loop_end_sample ||
+            vgmstream->loop_end_sample > num_samples))
+        goto reject;
+
+    bytes = (size_t)num_samples * output_channels * sizeof(sample_t);
+    if (bytes / output_channels / sizeof(sample_t) != (size_t)num_samples || bytes > cache->max_entry_bytes)
+        goto reject;
+
+
+    entry = calloc(1, sizeof(VGMSTREAM_PCMCACHE_ENTRY));
+    if (!entry) goto fail;
+
+    entry->filename = pcmcache_strdup(filename);
+    entry->config = pcmcache_strdup(config ? config : "");
+    if (!entry->filename || !entry->config) goto fail;
+    entry->subsong = subsong;
+
+    entry->samples = malloc(bytes);
+    if (!entry->samples) goto fail;
+    entry->samples_bytes = bytes;
+
+    /* mixed output is smaller than render's input, so downmixes need an extra buffer */
+    if (input_channels != output_channels) {
+        buf = malloc(buffer_samples * input_channels * sizeof(sample_t));
+        if (!buf) goto fail;
+    }
+
+    entry->info.channels = output_channels;
+    entry->info.sample_rate = vgmstream->sample_rate;
+    entry->info.num_samples = num_samples;
+    entry->info.loop_flag = vgmstream->loop_flag;
+    entry->info.loop_start_sample = vgmstream->loop_start_sample;
+    entry->info.loop_end_sample = vgmstream->loop_end_sample;
+    entry->info.loop_target = vgmstream->loop_target;
+
+
+    /* decode one linear pass (loops are recreated on render) */
+    if (entry->info.loop_flag)
+        vgmstream_force_loop(vgmstream, 0, 0, 0);
+
+    decoded = 0;
+    while (decoded < num_samples) {
+        int32_t samples_to_do = buffer_samples;
+        sample_t* dst = entry->samples + decoded * output_channels;
+        if (samples_to_do > num_samples - decoded)
+            samples_to_do = num_samples - decoded;
+
+        if (buf) {
+            render_vgmstream(buf, samples_to_do, vgmstream);
+            memcpy(dst, buf, samples_to_do * output_channels * sizeof(sample_t));
+        }
+        else {
+            render_vgmstream(dst, samples_to_do, vgmstream);
+        }
+
+        decoded += samples_to_do;
+    }
+
+    /* back to the player's initial state */
+    reset_vgmstream(vgmstream);
+    if (entry->info.loop_flag)
+        vgmstream_force_loop(vgmstream, 1, entry->info.loop_start_sample, entry->info.loop_end_sample);
+
+    free(buf);
+    buf = NULL;
+
+
+    /* register */
+    pcmcache_evict(cache, bytes);
+    if (cache->entries_count == cache->entries_max) {
+        int entries_max = cache->entries_max ? cache->entries_max * 2 : 16;
+        VGMSTREAM_PCMCACHE_ENTRY** entries = realloc(cache->entries, entries_max * sizeof(VGMSTREAM_PCMCACHE_ENTRY*));
+        if (!entries) goto fail;
+        cache->entries = entries;
+        cache->entries_max = entries_max;
+    }
+
+    entry->refs = 1;
+    entry->last_used = ++cache->use_counter;
+    cache->entries[cache->entries_count] = entry;
+    cache->entries_count++;
+    cache->stats.resident_bytes += bytes;
+    cache->stats.adds++;
+
+    return entry;
+
+reject:
+    cache->stats.rejects++;
+    return NULL;
+fail:
+    free(buf);
+    pcmcache_free_entry(entry);
+    return NULL;
+}
+
+void vgmstream_pcmcache_get_info(VGMSTREAM_PCMCACHE_ENTRY* entry, vgmstream_pcmcache_info* info) {
+    if (!entry || !info) return;
+    *info = entry->info;
+}
+
+/* maps a play position to a position in the decoded samples (-1 = silence), plus how many
+ * samples can be copied from there before the next jump */
+static int32_t pcmcache_get_source(vgmstream_pcmcache_info* info, int32_t position, int32_t* samples_avail) {
+    int64_t source = position;
+    int32_t source_end = info->num_samples;
+
+    if (info->loop_flag && position >= info->loop_end_sample) {
+        int32_t loop_samples = info->loop_end_sample - info->loop_start_sample;
+        int32_t loop_pos = position - info->loop_end_sample;
+
+        if (info->loop_target > 0 && loop_pos / loop_samples >= info->loop_target - 1) {
+            /* target reached: last loop plays up to the stream end */
+            source = (int64_t)position - (int64_t)(info->loop_target - 1) * loop_samples;
+        }
+        else {
+            source = info->loop_start_sample + loop_pos % loop_samples;
+            source_end = info->loop_end_sample;
+        }
+    }
+    else if (info->loop_flag) {
+        source_end = info->loop_end_sample;
+    }
+
+    if (source < 0 || source >= source_end) {
+        *samples_avail = 0x7FFFFFFF;
+        return -1;
+    }
+
+    *samples_avail = source_end - (int32_t)source;
+    return (int32_t)source;
+}
+
+void vgmstream_pcmcache_render(VGMSTREAM_PCMCACHE_ENTRY* entry, sample_t* buf, int32_t sample_count, int32_t position) {
+    int channels;
+
+    if (!entry || !buf) return;
+    channels = entry->info.channels;
+
+    while (sample_count > 0) {
+        int32_t samples_to_do;
+        int32_t source = pcmcache_get_source(&entry->info, position, &samples_to_do);
+        if (samples_to_do > sample_count)
+            samples_to_do = sample_count;
+
+        if (source < 0)
+            memset(buf, 0, samples_to_do * channels * sizeof(sample_t));
+        else
+            memcpy(buf, entry->samples + source * channels, samples_to_do * channels * sizeof(sample_t));
+
+        buf += samples_to_do * channels;
+        position += samples_to_do;
+        sample_count -= samples_to_do;
+    }
+}
+
+void vgmstream_pcmcache_release(VGMSTREAM_PCMCACHE_ENTRY* entry) {
+    if (!entry) return;
+
+    entry->refs--;
+    if (entry->refs <= 0 && entry->detached)
+        pcmcache_free_entry(entry);
+}
+
+void vgmstream_pcmcache_get_stats(VGMSTREAM_PCMCACHE* cache, vgmstream_pcmcache_stats* stats) {
+    if (!cache || !stats) return;
+
+    *stats = cache->stats;
+    stats->entries = cache->entries_count;
+}
+
+
+/* ****************************************** */
+/* NEGCACHE: remembers files that can't play  */
+/* ****************************************** */
+
+#define NEGCACHE_HEADER "vgmstream negcache"
+#define NEGCACHE_LINE_MAX (PATH_LIMIT + 0x20)
+
+typedef struct negcache_entry {
+    struct negcache_entry* next;
+    uint32_t hash;          /* of filename */
+    uint32_t stamp;         /* of file size + modification time */
+    char filename[1];       /* allocated with the entry */
+} negcache_entry;
+
+struct VGMSTREAM_NEGCACHE {
+    char* cache_filename;
+    char* version;
+    int max_entries;
+
+    negcache_entry** buckets;
+    int buckets_count;      /* power of 2 */
+    int entries_count;
+    int modified;
+};
+
+
+static uint32_t negcache_hash(const uint8_t* buf, size_t size, uint32_t hash) {
+    size_t i;
+
+    /* FNV-1a */
+    for (i = 0; i < size; i++) {
+        hash = (hash ^ buf[i]) * 0x01000193;
+    }
+    return hash;
+}
+
+static uint32_t negcache_hash_filename(const char* filename) {
+    return negcache_hash((const uint8_t*)filename, strlen(filename), 0x811C9DC5);
+}
+
+/* identifies current file contents without opening it, returns 0 if file can't be checked */
+static int negcache_get_stamp(const char* filename, uint32_t* stamp) {
+    struct stat st;
+    uint8_t buf[0x10];
+
+    if (stat(filename, &st) != 0)
+        return 0;
+    if ((st.st_mode & S_IFMT) != S_IFREG)
+        return 0;
+
+    put_32bitLE(buf + 0x00, (uint32_t)((uint64_t)st.st_size >> 0));
+    put_32bitLE(buf + 0x04, (uint32_t)((uint64_t)st.st_size >> 32));
+    put_32bitLE(buf + 0x08, (uint32_t)((uint64_t)st.st_mtime >> 0));
+    put_32bitLE(buf + 0x0c, (uint32_t)((uint64_t)st.st_mtime >> 32));
+    *stamp = negcache_hash(buf, sizeof(buf), 0x811C9DC5);
+    return 1;
+}
+
+static char* negcache_strdup(const char* str) {
+    size_t len = strlen(str) + 1;
+    char* dup = malloc(len);
+    if (dup) memcpy(dup, str, len);
+    return dup;
+}
+
+/* returns the link pointing to filename's entry (or to NULL at the end of its bucket if not found) */
+static negcache_entry** negcache_find(VGMSTREAM_NEGCACHE* cache, const char* filename, uint32_t hash) {
+    negcache_entry** link = &cache->buckets[hash & (cache->buckets_count - 1)];
+
+    while (*link) {
+        if ((*link)->hash == hash && strcmp((*link)->filename, filename) == 0)
+            break;
+        link = &(*link)->next;
+    }
+    return link;
+}
+
+static int negcache_grow(VGMSTREAM_NEGCACHE* cache) {
+    int i, buckets_count = cache->buckets_count ? cache->buckets_count * 2 : 256;
+    negcache_entry** buckets = calloc(buckets_count, sizeof(negcache_entry*));
+    if (!buckets) return 0;
+
+    for (i = 0; i < cache->buckets_count; i++) {
+        negcache_entry* entry = cache->buckets[i];
+        while (entry) {
+            negcache_entry* next = entry->next;
+            negcache_entry** bucket = &buckets[entry->hash & (buckets_count - 1)];
+            entry->next = *bucket;
+            *bucket = entry;
+            entry = next;
+        }
+    }
+
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->buckets_count = buckets_count;
+    return 1;
+}
+
+static void negcache_set(VGMSTREAM_NEGCACHE* cache, const char* filename, uint32_t stamp) {
+    uint32_t hash = negcache_hash_filename(filename);
+    negcache_entry** link;
+    negcache_entry* entry;
+    size_t len;
+
+    /* newlines would break the saved list */
+    if (strchr(filename, '\n') || strchr(filename, '\r'))
+        return;
+
+    link = negcache_find(cache, filename, hash);
+    if (*link) {
+        (*link)->stamp = stamp;
+        return;
+    }
+
+    if (cache->entries_count >= cache->max_entries)
+        return;
+    if (cache->entries_count >= cache->buckets_count) {
+        if (!negcache_grow(cache))
+            return;
+        link = negcache_find(cache, filename, hash);
+    }
+
+    len = strlen(filename);
+    entry = malloc(sizeof(negcache_entry) + len);
+    if (!entry) return;
+    entry->next = NULL;
+    entry->hash = hash;
+    entry->stamp = stamp;
+    memcpy(entry->filename, filename, len + 1);
+
+    *link = entry;
+    cache->entries_count++;
+}
+
+static void negcache_load(VGMSTREAM_NEGCACHE* cache) {
+    char line[NEGCACHE_LINE_MAX];
+    char header[NEGCACHE_LINE_MAX];
+    FILE* file;
+
+    file = fopen(cache->cache_filename, "r");
+    if (!file) return;
+
+    /* entries from other versions may be playable now */
+    snprintf(header, sizeof(header), "%s\t%s\n", NEGCACHE_HEADER, cache->version);
+    if (!fgets(line, sizeof(line), file) || strcmp(line, header) != 0)
+        goto end;
+
+    /* "(stamp)\t(filename)" */
+    while (fgets(line, sizeof(line), file)) {
+        uint32_t stamp;
+        char* filename;
+        size_t len = strlen(line);
+
+        if (len < 10 || line[len - 1] != '\n' || line[8] != '\t')
+            continue; /* cut or bad line */
+        line[len - 1] = '\0';
+        line[8] = '\0';
+        filename = &line[9];
+
+        if (sscanf(line, "%x", &stamp) != 1)
+            continue;
+        negcache_set(cache, filename, stamp);
+    }
+
+end:
+    fclose(file);
+}
+
+VGMSTREAM_NEGCACHE* vgmstream_negcache_init(const char* cache_filename, const char* version, int max_entries) {
+    VGMSTREAM_NEGCACHE* cache = NULL;
+
+    cache = calloc(1, sizeof(VGMSTREAM_NEGCACHE));
+    if (!cache) goto fail;
+
+    cache->max_entries = max_entries;
+    cache->version = negcache_strdup(version ? version : "");
+    if (!cache->version) goto fail;
+    if (cache_filename) {
+        cache->cache_filename = negcache_strdup(cache_filename);
+        if (!cache->cache_filename) goto fail;
+    }
+
+    if (!negcache_grow(cache))
+        goto fail;
+
+    if (cache->cache_filename)
+        negcache_load(cache);
+
+    return cache;
+fail:
+    vgmstream_negcache_close(cache);
+    return NULL;
+}
+
+int vgmstream_negcache_save(VGMSTREAM_NEGCACHE* cache) {
+    FILE* file;
+    int i;
+
+    if (!cache || !cache->cache_filename)
+        return 0;
+    if (!cache->modified)
+        return 1;
+
+    file = fopen(cache->cache_filename, "w");
+    if (!file) return 0;
+
+    fprintf(file, "%s\t%s\n", NEGCACHE_HEADER, cache->version);
+    for (i = 0; i < cache->buckets_count; i++) {
+        negcache_entry* entry;
+        for (entry = cache->buckets[i]; entry != NULL; entry = entry->next) {
+            fprintf(file, "%08x\t%s\n", entry->stamp, entry->filename);
+        }
+    }
+
+    if (ferror(file)) {
+        fclose(file);
+        return 0;
+    }
+    if (fclose(file) != 0)
+        return 0;
+
+    cache->modified = 0;
+    return 1;
+}
+
+void vgmstream_negcache_close(VGMSTREAM_NEGCACHE* cache) {
+    if (!cache) return;
+
+    vgmstream_negcache_clear(cache);
+    free(cache->buckets);
+    free(cache->cache_filename);
+    free(cache->version);
+    free(cache);
+}
+
+int vgmstream_negcache_is_rejected(VGMSTREAM_NEGCACHE* cache, const char* filename) {
+    negcache_entry** link;
+    negcache_entry* entry;
+    uint32_t stamp;
+
+    if (!cache || !filename)
+        return 0;
+
+    link = negcache_find(cache, filename, negcache_hash_filename(filename));
+    entry = *link;
+    if (!entry)
+        return 0;
+
+    if (negcache_get_stamp(filename, &stamp) && stamp == entry->stamp)
+        return 1;
+
+    /* changed or gone, probe again */
+    *link = entry->next;
+    free(entry);
+    cache->entries_count--;
+    cache->modified = 1;
+    return 0;
+}
+
+void vgmstream_negcache_add(VGMSTREAM_NEGCACHE* cache, const char* filename) {
+    uint32_t stamp;
+
+    if (!cache || !filename)
+        return;
+    if (!negcache_get_stamp(filename, &stamp))
+        return; /* can't tell if it changes later */
+
+    negcache_set(cache, filename, stamp);
+    cache->modified = 1;
+}
+
+void vgmstream_negcache_clear(VGMSTREAM_NEGCACHE* cache) {
+    int i;
+
+    if (!cache) return;
+
+    for (i = 0; i < cache->buckets_count; i++) {
+        negcache_entry* entry = cache->buckets[i];
+        while (entry) {
+            negcache_entry* next = entry->next;
+            free(entry);
+            entry = next;
+        }
+        cache->buckets[i] = NULL;
+    }
+
+    if (cache->entries_count > 0)
+        cache->modified = 1;
+    cache->entries_count = 0;
+}
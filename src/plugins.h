@@ -10,15 +10,18 @@
 /* CONTEXT: simplifies plugin code            */
 /* ****************************************** */
 
+typedef struct VGMSTREAM_NEGCACHE VGMSTREAM_NEGCACHE; /* see NEGCACHE below */
+
 typedef struct {
     int is_extension;           /* set if filename is already an extension */
     int skip_standard;          /* set if shouldn't check standard formats */
     int reject_extensionless;   /* set if player can't play extensionless files */
     int accept_unknown;         /* set to allow any extension (for txth) */
     int accept_common;          /* set to allow known-but-common extension (when player has plugin priority) */
+    VGMSTREAM_NEGCACHE* negcache; /* if set, rejects files that failed to open before (when not is_extension) */
 } vgmstream_ctx_valid_cfg;
 
-/* returns if vgmstream can parse file by extension */
+/* returns if vgmstream can parse file by extension (and isn't a known failure in negcache) */
 int vgmstream_ctx_is_valid(const char* filename, vgmstream_ctx_valid_cfg *cfg);
 
 #if 0
@@ -97,10 +100,157 @@ void vgmstream_tags_close(VGMSTREAM_TAGS* tags);
  * Needs to be enabled last after adding effects. */
 void vgmstream_mixing_enable(VGMSTREAM* vgmstream, int32_t max_sample_count, int *input_channels, int *output_channels);
 
+/* Sets resampling of the output to sample_rate (quality 0..3, higher is slower). Must be set before enabling
+ * mixing. Once enabled, render_vgmstream outputs samples at the new rate, while vgmstream's values
+ * (num_samples, loops, sample_rate) stay the same, and can be converted with the function below. */
+void vgmstream_mixing_resample(VGMSTREAM* vgmstream, int sample_rate, int quality);
+
+/* converts samples at vgmstream's sample rate to the resampled rate */
+int32_t vgmstream_mixing_resampled_samples(VGMSTREAM* vgmstream, int32_t samples);
+
 /* sets automatic downmixing if vgmstream's channels are higher than max_channels */
 void vgmstream_mixing_autodownmix(VGMSTREAM *vgmstream, int max_channels);
 
 /* sets a fadeout */
 //void vgmstream_mixing_fadeout(VGMSTREAM *vgmstream, float start_second, float duration_seconds);
 
+
+/* ****************************************** */
+/* PCMCACHE: reuses decoded samples           */
+/* ****************************************** */
+
+/* Keeps fully decoded (and mixed) samples of short streams, so players that repeatedly play
+ * the same subsong (ex. cues in a bank) can skip opening, parsing and decoding. Looping is
+ * done by copying the loop region again, so it's not always exact: codecs that carry state
+ * across loops (some ADPCM) or seek approximately (FFmpeg/Vorbis) may differ a bit after
+ * the first loop. Not thread-safe. */
+
+/* opaque cache and cached stream */
+typedef struct VGMSTREAM_PCMCACHE VGMSTREAM_PCMCACHE;
+typedef struct VGMSTREAM_PCMCACHE_ENTRY VGMSTREAM_PCMCACHE_ENTRY;
+
+typedef struct {
+    int channels;               /* output channels (after mixing) */
+    int sample_rate;
+    int32_t num_samples;
+    int loop_flag;
+    int32_t loop_start_sample;
+    int32_t loop_end_sample;
+    int loop_target;            /* loops to do before playing the end (0 = loop forever) */
+} vgmstream_pcmcache_info;
+
+typedef struct {
+    int64_t hits;
+    int64_t misses;
+    int64_t adds;
+    int64_t rejects;            /* streams too big or not cacheable */
+    int64_t evictions;
+    size_t resident_bytes;      /* decoded samples currently in cache */
+    int entries;
+} vgmstream_pcmcache_stats;
+
+/* Creates a cache that holds up to max_bytes of samples, taking streams up to max_entry_bytes. */
+VGMSTREAM_PCMCACHE* vgmstream_pcmcache_init(size_t max_bytes, size_t max_entry_bytes);
+
+/* Closes cache. Entries still in use are freed once released. */
+void vgmstream_pcmcache_close(VGMSTREAM_PCMCACHE* cache);
+
+/* Returns cached entry (must be released) or NULL if not found. Key is the filename, subsong and any
+ * string that identifies player config that alters output (mixing, loops; may include a file
+ * timestamp to detect changes), NULL if none. */
+VGMSTREAM_PCMCACHE_ENTRY* vgmstream_pcmcache_get(VGMSTREAM_PCMCACHE* cache, const char* filename, int subsong, const char* config);
+
+/* Decodes the whole vgmstream into a new entry (must be released) and returns it, or NULL if stream
+ * can't be cached (too big, has fades, etc). Mixing (if any) must be enabled first, buffer_samples
+ * being the max_sample_count passed to vgmstream_mixing_enable. Vgmstream is reset afterwards. */
+VGMSTREAM_PCMCACHE_ENTRY* vgmstream_pcmcache_add(VGMSTREAM_PCMCACHE* cache, const char* filename, int subsong, const char* config,
+        VGMSTREAM* vgmstream, int32_t buffer_samples);
+
+/* Gets info of entry's stream (what players would normally take from the vgmstream) */
+void vgmstream_pcmcache_get_info(VGMSTREAM_PCMCACHE_ENTRY* entry, vgmstream_pcmcache_info* info);
+
+/* Copies sample_count samples from play position (loops applied), like render_vgmstream.
+ * Position is tracked by the caller since entries may be shared. Outputs silence past the end. */
+void vgmstream_pcmcache_render(VGMSTREAM_PCMCACHE_ENTRY* entry, sample_t* buf, int32_t sample_count, int32_t position);
+
+/* Releases an entry got from get/add */
+void vgmstream_pcmcache_release(VGMSTREAM_PCMCACHE_ENTRY* entry);
+
+void vgmstream_pcmcache_get_stats(VGMSTREAM_PCMCACHE* cache, vgmstream_pcmcache_stats* stats);
+
+
+/* ****************************************** */
+/* PROFILING: per-stage counters              */
+/* ****************************************** */
+
+/* Counters are only accumulated if the library is compiled with VGM_PROFILING (otherwise profile
+ * is returned empty) and are global, adding up all streams opened and rendered since the last reset.
+ * Times are in nanoseconds and include nested stages (render includes decode, a segmented layout
+ * its segments' layouts, an init function files opened by it, etc). Not thread-safe. */
+
+#define VGMSTREAM_PROFILE_MAX_INITS     1024
+#define VGMSTREAM_PROFILE_MAX_CODINGS   256
+#define VGMSTREAM_PROFILE_MAX_LAYOUTS   128
+
+typedef struct {
+    int64_t calls;
+    int64_t count;              /* depends on stage (samples, bytes, rejections) */
+    int64_t time;
+} vgmstream_profile_counter;
+
+typedef struct {
+    int enabled;                /* library has profiling compiled in */
+
+    vgmstream_profile_counter detection;        /* init_vgmstream_from_STREAMFILE (count: files not recognized) */
+    vgmstream_profile_counter init_functions[VGMSTREAM_PROFILE_MAX_INITS]; /* by position in the init list (count: rejections) */
+    int init_functions_count;
+    vgmstream_profile_counter open_stream;      /* vgmstream_open_stream (codec init is usually part of init functions) */
+
+    vgmstream_profile_counter decode[VGMSTREAM_PROFILE_MAX_CODINGS]; /* decode_vgmstream by coding_t (count: samples) */
+    vgmstream_profile_counter render[VGMSTREAM_PROFILE_MAX_LAYOUTS]; /* layout rendering by layout_t, without mixing (count: samples) */
+    vgmstream_profile_counter mixing;           /* mix_vgmstream when some mix applies (count: samples) */
+    vgmstream_profile_counter resampling;       /* resampled output, including its render (count: samples) */
+
+    vgmstream_profile_counter stdio_reads;      /* STDIO streamfile reads (count: bytes) */
+    vgmstream_profile_counter stdio_misses;     /* reads going to the file, not in buffer (count: bytes) */
+    vgmstream_profile_counter stdio_opens;      /* STDIO streamfiles opened (count: buffer bytes, no time) */
+    vgmstream_profile_counter allocs;           /* VGMSTREAMs allocated (count: bytes, no time) */
+} vgmstream_profile;
+
+/* Copies current counters */
+void vgmstream_profile_get(vgmstream_profile* profile);
+
+/* Clears all counters */
+void vgmstream_profile_reset(void);
+
+
+/* ****************************************** */
+/* NEGCACHE: remembers files that can't play  */
+/* ****************************************** */
+
+/* Keeps a list of files that vgmstream failed to open, so library scans can skip probing them
+ * (trying every format, FFmpeg included) on rescans. Files are identified by path plus size and
+ * modification time, so changed files are probed again. Companion files added later (like a .txth)
+ * aren't noticed though, so players should offer some way to clear it. Not thread-safe. */
+
+/* Creates a cache of max_entries, loading entries from cache_filename (may be NULL to keep it in memory).
+ * Saved entries are ignored if they were written with a different version string (as a newer vgmstream
+ * may play them). */
+VGMSTREAM_NEGCACHE* vgmstream_negcache_init(const char* cache_filename, const char* version, int max_entries);
+
+/* Writes entries to cache_filename if they changed. Returns 0 on error. */
+int vgmstream_negcache_save(VGMSTREAM_NEGCACHE* cache);
+
+/* Closes cache (without saving) */
+void vgmstream_negcache_close(VGMSTREAM_NEGCACHE* cache);
+
+/* Returns 1 if filename is known to fail and hasn't changed since */
+int vgmstream_negcache_is_rejected(VGMSTREAM_NEGCACHE* cache, const char* filename);
+
+/* Marks filename as failing to open (call when it fails with the default subsong) */
+void vgmstream_negcache_add(VGMSTREAM_NEGCACHE* cache, const char* filename);
+
+/* Removes all entries */
+void vgmstream_negcache_clear(VGMSTREAM_NEGCACHE* cache);
+
 #endif /* _PLUGINS_H_ */
@@ -0,0 +1,123 @@
+#include "profiling.h"
+
+#ifdef VGM_PROFILING
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#endif
+
+
+/**
+ * Per-stage counters for instrumented builds (VGM_PROFILING). Hooks in the main code add the elapsed
+ * time of a stage plus some stage-dependent count to a global profile, that players can query to see
+ * where time goes (detection, decoding, layouts, mixing, I/O). Times are wall-clock nanoseconds,
+ * measured around each call, so they include nested stages.
+ *
+ * Counters are plain globals without locks, as a profiling build is meant to be run single-threaded.
+ * Without VGM_PROFILING hooks aren't compiled and queries return an empty profile.
+ */
+
+#ifdef VGM_PROFILING
+
+static vgmstream_profile profile;
+
+
+uint64_t profile_now(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+
+    if (frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)((double)counter.QuadPart * 1000000000.0 / frequency.QuadPart);
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+static void profile_add(vgmstream_profile_counter* counter, uint64_t start, int64_t count) {
+    counter->calls++;
+    counter->count += count;
+    counter->time += profile_now() - start;
+}
+
+
+void profile_add_init(int index, uint64_t start, int rejected) {
+    if (index < 0 || index >= VGMSTREAM_PROFILE_MAX_INITS)
+        return;
+    profile_add(&profile.init_functions[index], start, rejected);
+    if (profile.init_functions_count < index + 1)
+        profile.init_functions_count = index + 1;
+}
+
+void profile_add_detection(uint64_t start, int rejected) {
+    profile_add(&profile.detection, start, rejected);
+}
+
+void profile_add_open_stream(uint64_t start) {
+    profile_add(&profile.open_stream, start, 0);
+}
+
+void profile_add_decode(coding_t coding_type, uint64_t start, int32_t samples) {
+    if (coding_type < 0 || coding_type >= VGMSTREAM_PROFILE_MAX_CODINGS)
+        return;
+    profile_add(&profile.decode[coding_type], start, samples);
+}
+
+void profile_add_render(layout_t layout_type, uint64_t start, int32_t samples) {
+    if (layout_type < 0 || layout_type >= VGMSTREAM_PROFILE_MAX_LAYOUTS)
+        return;
+    profile_add(&profile.render[layout_type], start, samples);
+}
+
+void profile_add_mixing(uint64_t start, int32_t samples) {
+    profile_add(&profile.mixing, start, samples);
+}
+
+void profile_add_resampling(uint64_t start, int32_t samples) {
+    profile_add(&profile.resampling, start, samples);
+}
+
+void profile_add_stdio_read(uint64_t start, size_t bytes) {
+    profile_add(&profile.stdio_reads, start, bytes);
+}
+
+void profile_add_stdio_miss(uint64_t start, size_t bytes) {
+    profile_add(&profile.stdio_misses, start, bytes);
+}
+
+void profile_add_stdio_open(size_t buffer_size) {
+    profile.stdio_opens.calls++;
+    profile.stdio_opens.count += buffer_size;
+}
+
+void profile_add_alloc(size_t bytes) {
+    profile.allocs.calls++;
+    profile.allocs.count += bytes;
+}
+
+#endif
+
+
+void vgmstream_profile_get(vgmstream_profile* out) {
+    if (!out)
+        return;
+#ifdef VGM_PROFILING
+    memcpy(out, &profile, sizeof(vgmstream_profile));
+    out->enabled = 1;
+#else
+    memset(out, 0, sizeof(vgmstream_profile));
+#endif
+}
+
+void vgmstream_profile_reset(void) {
+#ifdef VGM_PROFILING
+    memset(&profile, 0, sizeof(vgmstream_profile));
+#endif
+}
@@ -0,0 +1,27 @@
+#ifndef _PROFILING_H_
+#define _PROFILING_H_
+
+#include "vgmstream.h"
+#include "plugins.h"
+
+/* Internal hooks for the per-stage counters (see plugins.h), only compiled with VGM_PROFILING.
+ * Callers keep a start time from profile_now() then add the elapsed time and count to a stage. */
+#ifdef VGM_PROFILING
+
+uint64_t profile_now(void);
+
+void profile_add_init(int index, uint64_t start, int rejected);
+void profile_add_detection(uint64_t start, int rejected);
+void profile_add_open_stream(uint64_t start);
+void profile_add_decode(coding_t coding_type, uint64_t start, int32_t samples);
+void profile_add_render(layout_t layout_type, uint64_t start, int32_t samples);
+void profile_add_mixing(uint64_t start, int32_t samples);
+void profile_add_resampling(uint64_t start, int32_t samples);
+void profile_add_stdio_read(uint64_t start, size_t bytes);
+void profile_add_stdio_miss(uint64_t start, size_t bytes);
+void profile_add_stdio_open(size_t buffer_size);
+void profile_add_alloc(size_t bytes);
+
+#endif
+
+#endif /* _PROFILING_H_ */
@@ -2,12 +2,18 @@
 #include <unistd.h>
 #endif
 #include "streamfile.h"
+#ifdef STDIO_USE_PREAD
+#include <errno.h>
+#endif
 #include "util.h"
 #include "vgmstream.h"
+#include "profiling.h"
+
 
+typedef struct stdio_handle_pool stdio_handle_pool;
 
 /* a STREAMFILE that operates via standard IO using a buffer */
-typedef struct {
+typedef struct STDIO_STREAMFILE {
     STREAMFILE sf;          /* callbacks */
 
     FILE * infile;          /* actual FILE */
@@ -18,17 +24,184 @@ typedef struct {
     size_t buffersize;      /* max buffer size */
     size_t validsize;       /* current buffer size */
     size_t filesize;        /* buffered file size */
+
+    /* optional limits shared with files opened from this one */
+    stdio_handle_pool *pool;
+    int is_parked;          /* FILE and buffer closed by the pool, reopened on next read */
+    struct STDIO_STREAMFILE *prev; /* pool's LRU list of open files (most recently read first) */
+    struct STDIO_STREAMFILE *next;
 } STDIO_STREAMFILE;
 
+/* Keeps open files (and their buffers) under some limit by closing least recently read ones.
+ * Meant for huge playlists (TXTP, segmented banks) that open many files but only read a few at once. */
+struct stdio_handle_pool {
+    int refs;               /* files using this pool */
+    int max_handles;        /* 0 = no limit */
+    size_t max_bytes;       /* 0 = no limit */
+    STDIO_STREAMFILE *head; /* most recently read */
+    STDIO_STREAMFILE *tail; /* next to park */
+    stdio_streamfile_stats stats;
+};
+
 static STREAMFILE* open_stdio_streamfile_buffer(const char * const filename, size_t buffersize);
 static STREAMFILE* open_stdio_streamfile_buffer_by_file(FILE *infile, const char * const filename, size_t buffersize);
+static STREAMFILE* open_stdio_internal(STDIO_STREAMFILE *streamfile, const char * const filename, size_t buffersize);
+
+static void pool_unlink(STDIO_STREAMFILE *streamfile) {
+    stdio_handle_pool *pool = streamfile->pool;
+
+    if (streamfile->prev)
+        streamfile->prev->next = streamfile->next;
+    else if (pool->head == streamfile)
+        pool->head = streamfile->next;
+    if (streamfile->next)
+        streamfile->next->prev = streamfile->prev;
+    else if (pool->tail == streamfile)
+        pool->tail = streamfile->prev;
+    streamfile->prev = NULL;
+    streamfile->next = NULL;
+}
+
+static void pool_park(STDIO_STREAMFILE *streamfile) {
+    stdio_handle_pool *pool = streamfile->pool;
+
+    pool_unlink(streamfile);
+    fclose(streamfile->infile);
+    streamfile->infile = NULL;
+    free(streamfile->buffer);
+    streamfile->buffer = NULL;
+    streamfile->validsize = 0;
+    streamfile->is_parked = 1;
+
+    pool->stats.open_handles--;
+    pool->stats.open_bytes -= streamfile->buffersize;
+    pool->stats.parks++;
+}
+
+/* marks file as most recently read, and closes others if over the limits */
+static void pool_touch(STDIO_STREAMFILE *streamfile) {
+    stdio_handle_pool *pool = streamfile->pool;
+
+    if (pool->head != streamfile) {
+        pool_unlink(streamfile);
+        streamfile->next = pool->head;
+        if (pool->head)
+            pool->head->prev = streamfile;
+        pool->head = streamfile;
+        if (!pool->tail)
+            pool->tail = streamfile;
+    }
+
+    while (pool->tail && pool->tail != streamfile &&
+            ((pool->max_handles && pool->stats.open_handles > pool->max_handles) ||
+             (pool->max_bytes && pool->stats.open_bytes > pool->max_bytes))) {
+        pool_park(pool->tail);
+    }
+}
+
+static void pool_add(STDIO_STREAMFILE *streamfile, stdio_handle_pool *pool) {
+    streamfile->pool = pool;
+    pool->refs++;
+    if (!streamfile->infile) /* virtual file */
+        return;
+
+    pool->stats.open_handles++;
+    pool->stats.open_bytes += streamfile->buffersize;
+    pool_touch(streamfile);
+}
+
+static void pool_remove(STDIO_STREAMFILE *streamfile) {
+    stdio_handle_pool *pool = streamfile->pool;
+
+    if (streamfile->infile) {
+        pool_unlink(streamfile);
+        pool->stats.open_handles--;
+        pool->stats.open_bytes -= streamfile->buffersize;
+    }
+
+    pool->refs--;
+    if (pool->refs == 0)
+        free(pool);
+    streamfile->pool = NULL;
+}
+
+static int pool_unpark(STDIO_STREAMFILE *streamfile) {
+    stdio_handle_pool *pool = streamfile->pool;
+
+    streamfile->buffer = calloc(streamfile->buffersize, 1);
+    if (!streamfile->buffer) goto fail;
+
+    streamfile->infile = fopen(streamfile->name, "rb");
+    if (!streamfile->infile) goto fail;
+
+    streamfile->is_parked = 0;
+    pool->stats.open_handles++;
+    pool->stats.open_bytes += streamfile->buffersize;
+    pool->stats.reopens++;
+    return 1;
+fail:
+    VGM_LOG("STDIO: can't reopen %s\n", streamfile->name);
+    free(streamfile->buffer);
+    streamfile->buffer = NULL;
+    return 0;
+}
+
+/* Reads from the FILE at offset. On POSIX a positioned read avoids the seek syscall (and stdio's
+ * own buffering) on every refill, while other systems go through fseek + fread. */
+static size_t read_stdio_file(STDIO_STREAMFILE *streamfile, uint8_t *dst, off_t offset, size_t length) {
+    size_t length_read = 0;
+#ifdef VGM_PROFILING
+    uint64_t profile_time = profile_now();
+#endif
+#ifdef STDIO_USE_PREAD
+    int fd = fileno(streamfile->infile);
+
+    while (length_read < length) {
+        ssize_t bytes = pread(fd, dst + length_read, length - length_read, offset + length_read);
+        if (bytes < 0 && errno == EINTR)
+            continue;
+        if (bytes <= 0) /* EOF or error */
+            break;
+        length_read += bytes;
+    }
+#else
+    /* position to new offset */
+    if (fseeko(streamfile->infile,offset,SEEK_SET)) {
+        return 0; /* this shouldn't happen in our code */
+    }
+
+#ifdef _MSC_VER
+    /* Workaround a bug that appears when compiling with MSVC (later versions).
+     * This bug is deterministic and seemingly appears randomly after seeking.
+     * It results in fread returning data from the wrong area of the file.
+     * HPS is one format that is almost always affected by this. */
+    fseek(streamfile->infile, ftell(streamfile->infile), SEEK_SET);
+#endif
+
+    length_read = fread(dst, sizeof(uint8_t), length, streamfile->infile);
+#endif
+
+#ifdef VGM_PROFILING
+    profile_add_stdio_miss(profile_time, length_read);
+#endif
+    return length_read;
+}
 
 static size_t read_stdio(STDIO_STREAMFILE *streamfile, uint8_t *dst, off_t offset, size_t length) {
     size_t length_read_total = 0;
+#ifdef VGM_PROFILING
+    uint64_t profile_time = profile_now();
+#endif
+
+    if (streamfile->is_parked && !pool_unpark(streamfile))
+        return 0;
 
     if (!streamfile->infile || !dst || length <= 0 || offset < 0)
         return 0;
 
+    if (streamfile->pool)
+        pool_touch(streamfile);
+
     //;VGM_LOG("STDIO: read %lx + %x (buf %lx + %x)\n", offset, length, streamfile->buffer_offset, streamfile->validsize);
 
     /* is the part of the requested length in the buffer? */
@@ -64,33 +237,26 @@ static size_t read_stdio(STDIO_STREAMFILE *streamfile, uint8_t *dst, off_t offse
         /* ignore requests at EOF */
         if (offset >= streamfile->filesize) {
             //offset = streamfile->filesize; /* seems fseek doesn't clamp offset */
-            VGM_ASSERT_ONCE(offset > streamfile->filesize, "STDIO: reading over filesize 0x%x @ 0x%x + 0x%x\n", streamfile->filesize, (uint32_t)offset, length);
+            VGM_ASSERT_ONCE(offset > streamfile->filesize, "STDIO: reading over filesize 0x%x @ 0x%x + 0x%x\n", (uint32_t)streamfile->filesize, (uint32_t)offset, (uint32_t)length);
             break;
         }
 
-        /* position to new offset */
-        if (fseeko(streamfile->infile,offset,SEEK_SET)) {
-            break; /* this shouldn't happen in our code */
-        }
+        /* big reads go straight to dst, as buffering them would just add a copy */
+        if (length >= streamfile->buffersize) {
+            size_t length_read = read_stdio_file(streamfile, dst, offset, length);
 
-#ifdef _MSC_VER
-        /* Workaround a bug that appears when compiling with MSVC (later versions).
-         * This bug is deterministic and seemingly appears randomly after seeking.
-         * It results in fread returning data from the wrong area of the file.
-         * HPS is one format that is almost always affected by this. */
-        fseek(streamfile->infile, ftell(streamfile->infile), SEEK_SET);
-#endif
+            offset += length_read;
+            length_read_total += length_read;
+            break; /* done or partial read (EOF) */
+        }
 
         /* fill the buffer (offset now is beyond buffer_offset) */
         streamfile->buffer_offset = offset;
-        streamfile->validsize = fread(streamfile->buffer, sizeof(uint8_t), streamfile->buffersize, streamfile->infile);
+        streamfile->validsize = read_stdio_file(streamfile, streamfile->buffer, offset, streamfile->buffersize);
         //;VGM_LOG("STDIO: read buf %lx + %x\n", streamfile->buffer_offset, streamfile->validsize);
 
         /* decide how much must be read this time */
-        if (length > streamfile->buffersize)
-            length_to_read = streamfile->buffersize;
-        else
-            length_to_read = length;
+        length_to_read = length;
 
         /* give up on partial reads (EOF) */
         if (streamfile->validsize < length_to_read) {
@@ -109,6 +275,9 @@ static size_t read_stdio(STDIO_STREAMFILE *streamfile, uint8_t *dst, off_t offse
     }
 
     streamfile->offset = offset; /* last fread offset */
+#ifdef VGM_PROFILING
+    profile_add_stdio_read(profile_time, length_read_total);
+#endif
     return length_read_total;
 }
 static size_t get_size_stdio(STDIO_STREAMFILE *streamfile) {
@@ -122,6 +291,8 @@ static void get_name_stdio(STDIO_STREAMFILE *streamfile, char *buffer, size_t le
     buffer[length-1]='\0';
 }
 static void close_stdio(STDIO_STREAMFILE *streamfile) {
+    if (streamfile->pool)
+        pool_remove(streamfile);
     if (streamfile->infile)
         fclose(streamfile->infile);
     free(streamfile->buffer);
@@ -129,9 +300,19 @@ static void close_stdio(STDIO_STREAMFILE *streamfile) {
 }
 
 static STREAMFILE* open_stdio(STDIO_STREAMFILE *streamfile, const char * const filename, size_t buffersize) {
+    STREAMFILE *new_sf;
+
     if (!filename)
         return NULL;
 
+    new_sf = open_stdio_internal(streamfile, filename, buffersize);
+    if (new_sf && streamfile->pool)
+        pool_add((STDIO_STREAMFILE*)new_sf, streamfile->pool);
+    return new_sf;
+}
+
+static STREAMFILE* open_stdio_internal(STDIO_STREAMFILE *streamfile, const char * const filename, size_t buffersize) {
+
 #if !defined (__ANDROID__)
     /* if same name, duplicate the file descriptor we already have open */
     if (streamfile->infile && !strcmp(streamfile->name,filename)) {
@@ -195,6 +376,9 @@ static STREAMFILE* open_stdio_streamfile_buffer_by_file(FILE *infile, const char
         goto fail; /* can be ignored but may result in strange/unexpected behaviors */
     }
 
+#ifdef VGM_PROFILING
+    profile_add_stdio_open(buffersize);
+#endif
     return &streamfile->sf;
 
 fail:
@@ -230,6 +414,33 @@ STREAMFILE* open_stdio_streamfile_by_file(FILE *file, const char *filename) {
     return open_stdio_streamfile_buffer_by_file(file, filename, STREAMFILE_DEFAULT_BUFFER_SIZE);
 }
 
+int set_stdio_streamfile_limits(STREAMFILE *streamfile, int max_handles, size_t max_bytes) {
+    STDIO_STREAMFILE *this_sf = (STDIO_STREAMFILE*)streamfile;
+
+    if (!streamfile || streamfile->read != (void*)read_stdio)
+        return 0;
+
+    if (!this_sf->pool) {
+        stdio_handle_pool *pool = calloc(1, sizeof(stdio_handle_pool));
+        if (!pool) return 0;
+        pool_add(this_sf, pool);
+    }
+
+    this_sf->pool->max_handles = max_handles;
+    this_sf->pool->max_bytes = max_bytes;
+    return 1;
+}
+
+int get_stdio_streamfile_stats(STREAMFILE *streamfile, stdio_streamfile_stats *stats) {
+    STDIO_STREAMFILE *this_sf = (STDIO_STREAMFILE*)streamfile;
+
+    if (!streamfile || !stats || streamfile->read != (void*)read_stdio || !this_sf->pool)
+        return 0;
+
+    *stats = this_sf->pool->stats;
+    return 1;
+}
+
 /* **************************************************** */
 
 typedef struct {
@@ -280,7 +491,7 @@ static size_t buffer_read(BUFFER_STREAMFILE *streamfile, uint8_t *dst, off_t off
         /* ignore requests at EOF */
         if (offset >= streamfile->filesize) {
             //offset = streamfile->filesize; /* seems fseek doesn't clamp offset */
-            VGM_ASSERT_ONCE(offset > streamfile->filesize, "BUFFER: reading over filesize 0x%x @ 0x%x + 0x%x\n", streamfile->filesize, (uint32_t)offset, length);
+            VGM_ASSERT_ONCE(offset > streamfile->filesize, "BUFFER: reading over filesize 0x%x @ 0x%x + 0x%x\n", (uint32_t)streamfile->filesize, (uint32_t)offset, (uint32_t)length);
             break;
         }
 
@@ -355,6 +566,8 @@ STREAMFILE* open_buffer_streamfile(STREAMFILE *streamfile, size_t buffer_size) {
     this_sf->sf.open = (void*)buffer_open;
     this_sf->sf.close = (void*)buffer_close;
     this_sf->sf.stream_index = streamfile->stream_index;
+    this_sf->sf.info_only = streamfile->info_only;
+    this_sf->sf.info_estimated = streamfile->info_estimated;
 
     this_sf->inner_sf = streamfile;
 
@@ -376,6 +589,382 @@ STREAMFILE* open_buffer_streamfile_f(STREAMFILE *streamfile, size_t buffer_size)
 
 /* **************************************************** */
 
+#define READAHEAD_MAX_SLOTS 8
+#define READAHEAD_ADAPTIVE_SLOTS 2      /* initial slots in adaptive mode (header + data) */
+#define READAHEAD_ADAPTIVE_CHUNK 0x1000 /* initial window in adaptive mode (small header reads) */
+
+typedef struct {
+    off_t buffer_offset;    /* slot data start */
+    size_t validsize;       /* slot data size */
+    off_t next_offset;      /* where this consumer's next read is expected */
+    int prefetched;         /* slot was filled ahead of a sequential consumer */
+    size_t window;          /* next fill size for a sequential consumer (adaptive mode) */
+    size_t buffer_size;     /* allocated size (grows with the window in adaptive mode) */
+    uint32_t last_used;     /* for LRU replacement */
+    uint8_t *buffer;        /* allocated on first use */
+} readahead_slot;
+
+typedef struct {
+    STREAMFILE sf;
+
+    STREAMFILE *inner_sf;
+    off_t offset;           /* last read offset (info) */
+    size_t filesize;        /* buffered file size */
+    size_t buffersize;      /* max slot size (read-ahead window) */
+    size_t chunksize;       /* fill size for random access */
+    int slot_count;
+    int adaptive;           /* slot count and windows follow the access pattern */
+    readahead_slot slots[READAHEAD_MAX_SLOTS];
+    uint32_t tick;
+
+    readahead_streamfile_stats stats;
+} READAHEAD_STREAMFILE;
+
+/* Finds the slot to refill for a read at offset. A slot whose consumer ended right before offset
+ * (or a bit before, for small skips) continues that stream; otherwise the least recently used is taken.
+ * In adaptive mode a new slot is added instead if the LRU one still feeds an active sequential
+ * consumer (used within the last round of reads), as happens with one offset per channel. */
+static readahead_slot* readahead_get_slot(READAHEAD_STREAMFILE *streamfile, off_t offset, int *p_sequential) {
+    readahead_slot *lru = &streamfile->slots[0];
+    int i;
+
+    for (i = 0; i < streamfile->slot_count; i++) {
+        readahead_slot *slot = &streamfile->slots[i];
+        off_t slot_end = slot->buffer_offset + slot->validsize;
+        /* skips allowed for a sequential consumer (interleaved blocks skip other channels) */
+        size_t max_skip = (streamfile->adaptive && slot->window > streamfile->chunksize) ? slot->window : streamfile->chunksize;
+
+        if (slot->validsize && offset >= slot_end && offset < slot_end + max_skip
+                && slot->next_offset == slot_end) {
+            *p_sequential = 1;
+            return slot;
+        }
+
+        if (slot->last_used < lru->last_used)
+            lru = slot;
+    }
+
+    *p_sequential = 0;
+    if (streamfile->adaptive && streamfile->slot_count < READAHEAD_MAX_SLOTS
+            && lru->validsize && streamfile->tick - lru->last_used <= streamfile->slot_count) {
+        lru = &streamfile->slots[streamfile->slot_count];
+        streamfile->slot_count++;
+    }
+    return lru;
+}
+
+static size_t readahead_read(READAHEAD_STREAMFILE *streamfile, uint8_t *dst, off_t offset, size_t length) {
+    size_t length_read_total = 0;
+    int stalled = 0, prefetched = 1;
+
+    if (!dst || length <= 0 || offset < 0)
+        return 0;
+
+    streamfile->stats.reads++;
+    streamfile->tick++;
+
+    while (length > 0) {
+        readahead_slot *slot = NULL;
+        size_t length_to_read;
+        off_t offset_into_buffer;
+        int i;
+
+        /* ignore requests at EOF */
+        if (offset >= streamfile->filesize) {
+            VGM_ASSERT_ONCE(offset > streamfile->filesize, "READAHEAD: reading over filesize 0x%x @ 0x%x + 0x%x\n", (uint32_t)streamfile->filesize, (uint32_t)offset, (uint32_t)length);
+            break;
+        }
+
+        /* is the part of the requested length in some slot? */
+        for (i = 0; i < streamfile->slot_count; i++) {
+            readahead_slot *curr = &streamfile->slots[i];
+            if (offset >= curr->buffer_offset && offset < curr->buffer_offset + curr->validsize) {
+                slot = curr;
+                break;
+            }
+        }
+
+        /* if not, refill: sequential consumers get the whole window, random access a small chunk */
+        if (!slot) {
+            int sequential;
+            size_t fill_size;
+
+            slot = readahead_get_slot(streamfile, offset, &sequential);
+
+            if (streamfile->adaptive) {
+                /* ramp up while the consumer stays sequential, restart small on seeks */
+                if (sequential) {
+                    slot->window = slot->window * 2;
+                    if (slot->window > streamfile->buffersize)
+                        slot->window = streamfile->buffersize;
+                }
+                else {
+                    slot->window = streamfile->chunksize;
+                }
+                fill_size = slot->window;
+            }
+            else {
+                fill_size = sequential ? streamfile->buffersize : streamfile->chunksize;
+            }
+            if (fill_size < length)
+                fill_size = length > streamfile->buffersize ? streamfile->buffersize : length;
+
+            if (slot->buffer_size < fill_size) {
+                size_t buffer_size = streamfile->adaptive ? fill_size : streamfile->buffersize;
+                uint8_t *buffer = realloc(slot->buffer, buffer_size);
+                if (!buffer) break;
+                slot->buffer = buffer;
+                slot->buffer_size = buffer_size;
+            }
+
+            slot->buffer_offset = offset;
+            slot->validsize = streamfile->inner_sf->read(streamfile->inner_sf, slot->buffer, offset, fill_size);
+            slot->next_offset = offset;
+            slot->prefetched = sequential;
+
+            stalled = 1;
+            if (sequential)
+                streamfile->stats.prefetches++;
+
+            if (slot->validsize == 0) /* EOF or read error */
+                break;
+        }
+
+        if (!slot->prefetched)
+            prefetched = 0;
+
+        offset_into_buffer = offset - slot->buffer_offset;
+        length_to_read = slot->validsize - offset_into_buffer;
+        if (length_to_read > length)
+            length_to_read = length;
+
+        memcpy(dst, slot->buffer + offset_into_buffer, length_to_read);
+        slot->next_offset = offset + length_to_read;
+        slot->last_used = streamfile->tick;
+
+        length_read_total += length_to_read;
+        length -= length_to_read;
+        offset += length_to_read;
+        dst += length_to_read;
+    }
+
+    if (stalled)
+        streamfile->stats.stalls++;
+    else {
+        streamfile->stats.hits++;
+        if (prefetched && length_read_total)
+            streamfile->stats.prefetch_hits++;
+    }
+
+    streamfile->offset = offset; /* last read offset */
+    return length_read_total;
+}
+static size_t readahead_get_size(READAHEAD_STREAMFILE *streamfile) {
+    return streamfile->filesize; /* cache */
+}
+static size_t readahead_get_offset(READAHEAD_STREAMFILE *streamfile) {
+    return streamfile->offset; /* cache */
+}
+static void readahead_get_name(READAHEAD_STREAMFILE *streamfile, char *buffer, size_t length) {
+    streamfile->inner_sf->get_name(streamfile->inner_sf, buffer, length); /* default */
+}
+static STREAMFILE *readahead_open(READAHEAD_STREAMFILE *streamfile, const char * const filename, size_t buffersize) {
+    STREAMFILE *new_inner_sf = streamfile->inner_sf->open(streamfile->inner_sf,filename,buffersize);
+    return open_readahead_streamfile_f(new_inner_sf, streamfile->buffersize, streamfile->adaptive ? 0 : streamfile->slot_count);
+}
+static void readahead_close(READAHEAD_STREAMFILE *streamfile) {
+    int i;
+
+    VGM_LOG("READAHEAD: reads=%u, hits=%u, stalls=%u, prefetches=%u, prefetch hits=%u, slots=%i\n",
+            streamfile->stats.reads, streamfile->stats.hits, streamfile->stats.stalls,
+            streamfile->stats.prefetches, streamfile->stats.prefetch_hits, streamfile->slot_count);
+
+    streamfile->inner_sf->close(streamfile->inner_sf);
+    for (i = 0; i < streamfile->slot_count; i++) {
+        free(streamfile->slots[i].buffer);
+    }
+    free(streamfile);
+}
+
+STREAMFILE* open_readahead_streamfile(STREAMFILE *streamfile, size_t buffer_size, int slot_count) {
+    READAHEAD_STREAMFILE *this_sf = NULL;
+
+    if (!streamfile) goto fail;
+
+    this_sf = calloc(1, sizeof(READAHEAD_STREAMFILE));
+    if (!this_sf) goto fail;
+
+    this_sf->buffersize = buffer_size;
+    if (this_sf->buffersize == 0)
+        this_sf->buffersize = STREAMFILE_READAHEAD_BUFFER_SIZE;
+    this_sf->adaptive = (slot_count <= 0);
+    this_sf->chunksize = this_sf->adaptive ? READAHEAD_ADAPTIVE_CHUNK : STREAMFILE_DEFAULT_BUFFER_SIZE;
+    if (this_sf->chunksize > this_sf->buffersize)
+        this_sf->chunksize = this_sf->buffersize;
+
+    this_sf->slot_count = this_sf->adaptive ? READAHEAD_ADAPTIVE_SLOTS : slot_count;
+    if (this_sf->slot_count > READAHEAD_MAX_SLOTS)
+        this_sf->slot_count = READAHEAD_MAX_SLOTS;
+
+    /* set callbacks and internals */
+    this_sf->sf.read = (void*)readahead_read;
+    this_sf->sf.get_size = (void*)readahead_get_size;
+    this_sf->sf.get_offset = (void*)readahead_get_offset;
+    this_sf->sf.get_name = (void*)readahead_get_name;
+    this_sf->sf.open = (void*)readahead_open;
+    this_sf->sf.close = (void*)readahead_close;
+    this_sf->sf.stream_index = streamfile->stream_index;
+    this_sf->sf.info_only = streamfile->info_only;
+    this_sf->sf.info_estimated = streamfile->info_estimated;
+
+    this_sf->inner_sf = streamfile;
+
+    this_sf->filesize = streamfile->get_size(streamfile);
+
+    return &this_sf->sf;
+
+fail:
+    free(this_sf);
+    return NULL;
+}
+STREAMFILE* open_readahead_streamfile_f(STREAMFILE *streamfile, size_t buffer_size, int slot_count) {
+    STREAMFILE *new_sf = open_readahead_streamfile(streamfile, buffer_size, slot_count);
+    if (!new_sf)
+        close_streamfile(streamfile);
+    return new_sf;
+}
+
+int get_readahead_streamfile_stats(STREAMFILE *streamfile, readahead_streamfile_stats *stats) {
+    READAHEAD_STREAMFILE *this_sf = (READAHEAD_STREAMFILE*)streamfile;
+
+    if (!streamfile || !stats || streamfile->read != (void*)readahead_read)
+        return 0;
+
+    *stats = this_sf->stats;
+    stats->slots = this_sf->slot_count;
+    return 1;
+}
+
+/* **************************************************** */
+
+/* blocks bigger than this are read normally (probably a bad block size anyway) */
+#define BLOCK_STREAMFILE_MAX_SIZE 0x200000
+
+typedef struct {
+    STREAMFILE sf;
+
+    STREAMFILE *inner_sf;
+    off_t offset;           /* last read offset (info) */
+    off_t block_offset;     /* loaded block start */
+    size_t block_size;      /* loaded block size */
+    size_t buffersize;      /* allocated size (biggest block so far) */
+    uint8_t *buffer;
+} BLOCK_STREAMFILE;
+
+static size_t block_read(BLOCK_STREAMFILE *streamfile, uint8_t *dst, off_t offset, size_t length) {
+    size_t length_read = 0;
+
+    if (!dst || length <= 0 || offset < 0)
+        return 0;
+
+    /* serve the part inside the loaded block from memory */
+    if (offset >= streamfile->block_offset && offset < streamfile->block_offset + streamfile->block_size) {
+        off_t offset_into_buffer = offset - streamfile->block_offset;
+
+        length_read = streamfile->block_size - offset_into_buffer;
+        if (length_read > length)
+            length_read = length;
+        memcpy(dst, streamfile->buffer + offset_into_buffer, length_read);
+
+        offset += length_read;
+        length -= length_read;
+        dst += length_read;
+    }
+
+    /* headers, data spilling outside the block, etc */
+    if (length > 0)
+        length_read += streamfile->inner_sf->read(streamfile->inner_sf, dst, offset, length);
+
+    streamfile->offset = offset; /* last read offset */
+    return length_read;
+}
+static size_t block_get_size(BLOCK_STREAMFILE *streamfile) {
+    return streamfile->inner_sf->get_size(streamfile->inner_sf); /* default */
+}
+static size_t block_get_offset(BLOCK_STREAMFILE *streamfile) {
+    return streamfile->offset; /* cache */
+}
+static void block_get_name(BLOCK_STREAMFILE *streamfile, char *buffer, size_t length) {
+    streamfile->inner_sf->get_name(streamfile->inner_sf, buffer, length); /* default */
+}
+static STREAMFILE *block_open(BLOCK_STREAMFILE *streamfile, const char * const filename, size_t buffersize) {
+    STREAMFILE *new_inner_sf = streamfile->inner_sf->open(streamfile->inner_sf,filename,buffersize);
+    return open_block_streamfile(new_inner_sf);
+}
+static void block_close(BLOCK_STREAMFILE *streamfile) {
+    streamfile->inner_sf->close(streamfile->inner_sf);
+    free(streamfile->buffer);
+    free(streamfile);
+}
+
+STREAMFILE* open_block_streamfile(STREAMFILE *streamfile) {
+    BLOCK_STREAMFILE *this_sf = NULL;
+
+    if (!streamfile) return NULL;
+
+    this_sf = calloc(1,sizeof(BLOCK_STREAMFILE));
+    if (!this_sf) return NULL;
+
+    /* set callbacks and internals */
+    this_sf->sf.read = (void*)block_read;
+    this_sf->sf.get_size = (void*)block_get_size;
+    this_sf->sf.get_offset = (void*)block_get_offset;
+    this_sf->sf.get_name = (void*)block_get_name;
+    this_sf->sf.open = (void*)block_open;
+    this_sf->sf.close = (void*)block_close;
+    this_sf->sf.stream_index = streamfile->stream_index;
+    this_sf->sf.info_only = streamfile->info_only;
+    this_sf->sf.info_estimated = streamfile->info_estimated;
+
+    this_sf->inner_sf = streamfile;
+
+    return &this_sf->sf;
+}
+STREAMFILE* open_block_streamfile_f(STREAMFILE *streamfile) {
+    STREAMFILE *new_sf = open_block_streamfile(streamfile);
+    if (!new_sf)
+        close_streamfile(streamfile);
+    return new_sf;
+}
+
+int load_block_streamfile(STREAMFILE *streamfile, off_t offset, size_t size) {
+    BLOCK_STREAMFILE *this_sf = (BLOCK_STREAMFILE*)streamfile;
+
+    if (!streamfile || streamfile->read != (void*)block_read)
+        return 0;
+    if (offset == this_sf->block_offset && size == this_sf->block_size)
+        return 1; /* already loaded */
+
+    /* forget current block (reads go to the inner streamfile) in case of errors */
+    this_sf->block_offset = 0;
+    this_sf->block_size = 0;
+
+    if (offset < 0 || size == 0 || size > BLOCK_STREAMFILE_MAX_SIZE)
+        return 0;
+
+    if (this_sf->buffersize < size) {
+        uint8_t *buffer = realloc(this_sf->buffer, size);
+        if (!buffer) return 0;
+        this_sf->buffer = buffer;
+        this_sf->buffersize = size;
+    }
+
+    /* may be smaller at EOF, the rest is read normally */
+    this_sf->block_size = this_sf->inner_sf->read(this_sf->inner_sf, this_sf->buffer, offset, size);
+    this_sf->block_offset = offset;
+    return 1;
+}
+
 //todo stream_index: copy? pass? funtion? external?
 //todo use realnames on reopen? simplify?
 //todo use safe string ops, this ain't easy
@@ -422,6 +1011,8 @@ STREAMFILE* open_wrap_streamfile(STREAMFILE *streamfile) {
     this_sf->sf.open = (void*)wrap_open;
     this_sf->sf.close = (void*)wrap_close;
     this_sf->sf.stream_index = streamfile->stream_index;
+    this_sf->sf.info_only = streamfile->info_only;
+    this_sf->sf.info_estimated = streamfile->info_estimated;
 
     this_sf->inner_sf = streamfile;
 
@@ -494,6 +1085,8 @@ STREAMFILE* open_clamp_streamfile(STREAMFILE *streamfile, off_t start, size_t si
     this_sf->sf.open = (void*)clamp_open;
     this_sf->sf.close = (void*)clamp_close;
     this_sf->sf.stream_index = streamfile->stream_index;
+    this_sf->sf.info_only = streamfile->info_only;
+    this_sf->sf.info_estimated = streamfile->info_estimated;
 
     this_sf->inner_sf = streamfile;
     this_sf->start = start;
@@ -565,6 +1158,8 @@ STREAMFILE* open_io_streamfile(STREAMFILE *streamfile, void *data, size_t data_s
     this_sf->sf.open = (void*)io_open;
     this_sf->sf.close = (void*)io_close;
     this_sf->sf.stream_index = streamfile->stream_index;
+    this_sf->sf.info_only = streamfile->info_only;
+    this_sf->sf.info_estimated = streamfile->info_estimated;
 
     this_sf->inner_sf = streamfile;
     if (data) {
@@ -590,6 +1185,208 @@ STREAMFILE* open_io_streamfile_f(STREAMFILE *streamfile, void *data, size_t data
 
 /* **************************************************** */
 
+typedef struct {
+    STREAMFILE sf;
+
+    STREAMFILE *inner_sf;
+    decrypt_streamfile_config cfg;  /* key points to key_stream */
+    uint8_t *key_stream;            /* key repeated N times, to XOR in long runs */
+    size_t key_stream_size;
+
+    uint8_t *buffer;                /* decrypted data */
+    off_t buffer_offset;
+    size_t buffer_size;
+    size_t valid_size;
+} DECRYPT_STREAMFILE;
+
+static inline uint8_t decrypt_reverse_bits(uint8_t val) {
+    val = ((val & 0xF0) >> 4) | ((val & 0x0F) << 4);
+    val = ((val & 0xCC) >> 2) | ((val & 0x33) << 2);
+    val = ((val & 0xAA) >> 1) | ((val & 0x55) << 1);
+    return val;
+}
+
+/* each op is a simple loop over the whole buffer (no LUTs or modulo per byte) so compilers can vectorize them */
+static void decrypt_data(DECRYPT_STREAMFILE *streamfile, uint8_t *buf, off_t offset, size_t length) {
+    const decrypt_streamfile_config *cfg = &streamfile->cfg;
+    size_t i, size = length;
+
+    /* clip to encrypted range */
+    if (offset + (off_t)length <= cfg->start)
+        return;
+    if (cfg->end && offset >= cfg->end)
+        return;
+    if (offset < cfg->start) {
+        size_t skip = cfg->start - offset;
+        buf += skip;
+        size -= skip;
+        offset += skip;
+    }
+    if (cfg->end && offset + (off_t)size > cfg->end)
+        size = cfg->end - offset;
+
+    if (cfg->reverse_bits_pre) {
+        for (i = 0; i < size; i++) {
+            buf[i] = decrypt_reverse_bits(buf[i]);
+        }
+    }
+
+    if (cfg->key_size) {
+        uint8_t *dst = buf;
+        size_t left = size;
+        size_t pos = (cfg->key_start + (offset - cfg->start)) % streamfile->key_stream_size;
+
+        while (left > 0) {
+            const uint8_t *xor = streamfile->key_stream + pos;
+            size_t bytes_to_do = streamfile->key_stream_size - pos;
+            if (bytes_to_do > left)
+                bytes_to_do = left;
+
+            for (i = 0; i < bytes_to_do; i++) {
+                dst[i] ^= xor[i];
+            }
+
+            dst += bytes_to_do;
+            left -= bytes_to_do;
+            pos = 0;
+        }
+    }
+
+    if (cfg->reverse_bits_post) {
+        for (i = 0; i < size; i++) {
+            buf[i] = decrypt_reverse_bits(buf[i]);
+        }
+    }
+
+    if (cfg->nibble_swap) {
+        for (i = 0; i < size; i++) {
+            buf[i] = (buf[i] << 4) | (buf[i] >> 4);
+        }
+    }
+}
+
+static size_t decrypt_read(DECRYPT_STREAMFILE *streamfile, uint8_t *dst, off_t offset, size_t length) {
+    size_t length_read_total = 0;
+
+    if (!dst || length <= 0 || offset < 0)
+        return 0;
+
+    while (length > 0) {
+        size_t length_to_read;
+        off_t offset_into_buffer;
+
+        if (offset < streamfile->buffer_offset || offset >= streamfile->buffer_offset + streamfile->valid_size) {
+
+            /* big reads don't need to be kept */
+            if (length >= streamfile->buffer_size) {
+                size_t bytes_read = streamfile->inner_sf->read(streamfile->inner_sf, dst, offset, length);
+                decrypt_data(streamfile, dst, offset, bytes_read);
+                length_read_total += bytes_read;
+                break;
+            }
+
+            streamfile->buffer_offset = offset;
+            streamfile->valid_size = streamfile->inner_sf->read(streamfile->inner_sf, streamfile->buffer, offset, streamfile->buffer_size);
+            decrypt_data(streamfile, streamfile->buffer, offset, streamfile->valid_size);
+            if (streamfile->valid_size == 0) /* EOF */
+                break;
+        }
+
+        offset_into_buffer = offset - streamfile->buffer_offset;
+        length_to_read = streamfile->valid_size - offset_into_buffer;
+        if (length_to_read > length)
+            length_to_read = length;
+
+        memcpy(dst, streamfile->buffer + offset_into_buffer, length_to_read);
+        length_read_total += length_to_read;
+        length -= length_to_read;
+        offset += length_to_read;
+        dst += length_to_read;
+    }
+
+    return length_read_total;
+}
+static size_t decrypt_get_size(DECRYPT_STREAMFILE *streamfile) {
+    return streamfile->inner_sf->get_size(streamfile->inner_sf); /* default */
+}
+static off_t decrypt_get_offset(DECRYPT_STREAMFILE *streamfile) {
+    return streamfile->inner_sf->get_offset(streamfile->inner_sf); /* default */
+}
+static void decrypt_get_name(DECRYPT_STREAMFILE *streamfile, char *buffer, size_t length) {
+    streamfile->inner_sf->get_name(streamfile->inner_sf, buffer, length); /* default */
+}
+static STREAMFILE* decrypt_open(DECRYPT_STREAMFILE *streamfile, const char * const filename, size_t buffersize) {
+    STREAMFILE *new_inner_sf = streamfile->inner_sf->open(streamfile->inner_sf,filename,buffersize);
+    return open_decrypt_streamfile_f(new_inner_sf, &streamfile->cfg);
+}
+static void decrypt_close(DECRYPT_STREAMFILE *streamfile) {
+    streamfile->inner_sf->close(streamfile->inner_sf);
+    free(streamfile->key_stream);
+    free(streamfile->buffer);
+    free(streamfile);
+}
+
+STREAMFILE* open_decrypt_streamfile(STREAMFILE *streamfile, const decrypt_streamfile_config *cfg) {
+    DECRYPT_STREAMFILE *this_sf = NULL;
+
+    if (!streamfile || !cfg) goto fail;
+    if (cfg->key_size && !cfg->key) goto fail;
+
+    this_sf = calloc(1, sizeof(DECRYPT_STREAMFILE));
+    if (!this_sf) goto fail;
+
+    this_sf->cfg = *cfg;
+
+    /* repeat small keys so XOR runs are long enough */
+    if (cfg->key_size) {
+        size_t i, repeats = (0x100 + cfg->key_size - 1) / cfg->key_size;
+
+        this_sf->key_stream_size = cfg->key_size * repeats;
+        this_sf->key_stream = malloc(this_sf->key_stream_size);
+        if (!this_sf->key_stream) goto fail;
+
+        for (i = 0; i < this_sf->key_stream_size; i++) {
+            this_sf->key_stream[i] = cfg->key[i % cfg->key_size];
+        }
+        this_sf->cfg.key = this_sf->key_stream;
+    }
+
+    this_sf->buffer_size = STREAMFILE_DEFAULT_BUFFER_SIZE;
+    this_sf->buffer = malloc(this_sf->buffer_size);
+    if (!this_sf->buffer) goto fail;
+
+    /* set callbacks and internals */
+    this_sf->sf.read = (void*)decrypt_read;
+    this_sf->sf.get_size = (void*)decrypt_get_size;
+    this_sf->sf.get_offset = (void*)decrypt_get_offset;
+    this_sf->sf.get_name = (void*)decrypt_get_name;
+    this_sf->sf.open = (void*)decrypt_open;
+    this_sf->sf.close = (void*)decrypt_close;
+    this_sf->sf.stream_index = streamfile->stream_index;
+    this_sf->sf.info_only = streamfile->info_only;
+    this_sf->sf.info_estimated = streamfile->info_estimated;
+
+    this_sf->inner_sf = streamfile;
+
+    return &this_sf->sf;
+
+fail:
+    if (this_sf) {
+        free(this_sf->key_stream);
+        free(this_sf->buffer);
+    }
+    free(this_sf);
+    return NULL;
+}
+STREAMFILE* open_decrypt_streamfile_f(STREAMFILE *streamfile, const decrypt_streamfile_config *cfg) {
+    STREAMFILE *new_sf = open_decrypt_streamfile(streamfile, cfg);
+    if (!new_sf)
+        close_streamfile(streamfile);
+    return new_sf;
+}
+
+/* **************************************************** */
+
 typedef struct {
     STREAMFILE sf;
 
@@ -645,6 +1442,8 @@ STREAMFILE* open_fakename_streamfile(STREAMFILE *streamfile, const char *fakenam
     this_sf->sf.open = (void*)fakename_open;
     this_sf->sf.close = (void*)fakename_close;
     this_sf->sf.stream_index = streamfile->stream_index;
+    this_sf->sf.info_only = streamfile->info_only;
+    this_sf->sf.info_estimated = streamfile->info_estimated;
 
     this_sf->inner_sf = streamfile;
 
@@ -798,6 +1597,8 @@ STREAMFILE* open_multifile_streamfile(STREAMFILE **streamfiles, size_t streamfil
     this_sf->sf.open = (void*)multifile_open;
     this_sf->sf.close = (void*)multifile_close;
     this_sf->sf.stream_index = streamfiles[0]->stream_index;
+    this_sf->sf.info_only = streamfiles[0]->info_only;
+    this_sf->sf.info_estimated = streamfiles[0]->info_estimated;
 
     this_sf->inner_sfs_size = streamfiles_size;
     this_sf->inner_sfs = calloc(streamfiles_size, sizeof(STREAMFILE*));
@@ -1261,7 +2062,7 @@ void dump_streamfile(STREAMFILE *streamFile, int num) {
         if (!f) return;
     }
 
-    VGM_LOG("dump streamfile: size %x\n", get_streamfile_size(streamFile));
+    VGM_LOG("dump streamfile: size %x\n", (uint32_t)get_streamfile_size(streamFile));
     while (offset < get_streamfile_size(streamFile)) {
         uint8_t buffer[0x8000];
         size_t read;
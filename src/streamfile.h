@@ -45,6 +45,12 @@
 #define fseeko fseek
 #endif
 
+/* STDIO streamfiles read with POSIX pread, which doesn't use the FILE's position. Since reopened
+ * files share the position of duplicated handles, only then they can be read from multiple threads. */
+#if !defined(_WIN32) && !defined(XBMC)
+#define STDIO_USE_PREAD
+#endif
+
 #ifndef DIR_SEPARATOR
 #if defined (_WIN32) || defined (WIN32)
 #define DIR_SEPARATOR '\\'
@@ -61,6 +67,10 @@
  * Value can be adjusted freely but 8k is a good enough compromise. */
 #define STREAMFILE_DEFAULT_BUFFER_SIZE 0x8000
 
+/* Read-ahead streamfiles fill this much when a consumer reads sequentially, so slow
+ * storage (network/optical/spinning disks) is hit less often during playback. */
+#define STREAMFILE_READAHEAD_BUFFER_SIZE 0x40000
+
 /* struct representing a file with callbacks. Code should use STREAMFILEs and not std C functions
  * to do file operations, as plugins may need to provide their own callbacks.
  * Reads from arbitrary offsets, meaning internally may need fseek equivalents during reads. */
@@ -78,6 +88,14 @@ typedef struct _STREAMFILE {
      * Not ideal here, but it's the simplest way to pass to all init_vgmstream_x functions. */
     int stream_index; /* 0=default/auto (first), 1=first, N=Nth */
 
+    /* Set by plugins that only need info (listing/tags) rather than playback. Metas may then
+     * estimate values that need a full scan (like VBR sample counts) from the first frames. */
+    int info_only;
+    /* Set during init to flag that something was estimated (internal use). Points to info_estimated_flag
+     * of the file being opened, so wrappers of it (that can't outlive it) share the same flag. */
+    int* info_estimated;
+    int info_estimated_flag;
+
 } STREAMFILE;
 
 /* All open_ fuctions should be safe to call with wrong/null parameters.
@@ -91,12 +109,59 @@ STREAMFILE* open_stdio_streamfile(const char *filename);
 /* Opens a standard STREAMFILE from a pre-opened FILE. */
 STREAMFILE* open_stdio_streamfile_by_file(FILE *file, const char *filename);
 
+/* Limits open files and buffer memory for this standard STREAMFILE and all files later opened from it
+ * (like segments of a TXTP or playlist). When over the limits, least recently read files are closed and
+ * transparently reopened by name once read again. 0 = no limit. Returns 0 if not a standard STREAMFILE. */
+int set_stdio_streamfile_limits(STREAMFILE *streamfile, int max_handles, size_t max_bytes);
+
+typedef struct {
+    int open_handles;       /* files currently open */
+    size_t open_bytes;      /* buffer memory of open files */
+    uint32_t parks;         /* files closed to stay under limits */
+    uint32_t reopens;       /* closed files opened again on read */
+} stdio_streamfile_stats;
+
+/* Copies counters shared by all files under the same limits. Returns 0 if limits weren't set. */
+int get_stdio_streamfile_stats(STREAMFILE *streamfile, stdio_streamfile_stats *stats);
+
 /* Opens a STREAMFILE that does buffered IO.
  * Can be used when the underlying IO may be slow (like when using custom IO).
  * Buffer size is optional. */
 STREAMFILE* open_buffer_streamfile(STREAMFILE *streamfile, size_t buffer_size);
 STREAMFILE* open_buffer_streamfile_f(STREAMFILE *streamfile, size_t buffer_size);
 
+/* Opens a STREAMFILE that buffers reads in multiple slots (one per consumer, like each channel's
+ * offset when they share a file), reading ahead a bigger window once a consumer reads sequentially.
+ * Random reads use smaller chunks. Can be used when the underlying IO is slow (remote/optical files).
+ * Buffer size (max read-ahead window) is optional. With slot_count 0 it adapts to the access
+ * pattern: slots are added while more sequential consumers appear (up to 8) and each slot's
+ * window ramps up from a small chunk while its consumer keeps reading sequentially, so header
+ * parsing stays cheap. Wraps any STREAMFILE, meant for unbuffered plugin IO. */
+STREAMFILE* open_readahead_streamfile(STREAMFILE *streamfile, size_t buffer_size, int slot_count);
+STREAMFILE* open_readahead_streamfile_f(STREAMFILE *streamfile, size_t buffer_size, int slot_count);
+
+typedef struct {
+    uint32_t reads;         /* read calls */
+    uint32_t hits;          /* reads fully served from buffered data */
+    uint32_t stalls;        /* reads that had to wait for the underlying streamfile */
+    uint32_t prefetches;    /* read-ahead fills for sequential consumers */
+    uint32_t prefetch_hits; /* hits served from read-ahead data */
+    uint32_t slots;         /* slots in use (grows in adaptive mode) */
+} readahead_streamfile_stats;
+
+/* Copies read-ahead counters (prefetch hit rate = prefetch_hits / reads). Returns 0 if not a read-ahead streamfile. */
+int get_readahead_streamfile_stats(STREAMFILE *streamfile, readahead_streamfile_stats *stats);
+
+/* Opens a STREAMFILE that serves reads from a whole block loaded at once with load_block_streamfile,
+ * passing reads outside it to the underlying streamfile. Used by blocked layouts so all channels
+ * share one block in memory, instead of one buffered streamfile per channel. */
+STREAMFILE* open_block_streamfile(STREAMFILE *streamfile);
+STREAMFILE* open_block_streamfile_f(STREAMFILE *streamfile);
+
+/* Reads size bytes at offset into the block buffer in one go (does nothing if already loaded).
+ * Returns 0 if not a block streamfile or the block can't be loaded (reads are then passed as-is). */
+int load_block_streamfile(STREAMFILE *streamfile, off_t offset, size_t size);
+
 /* Opens a STREAMFILE that doesn't close the underlying streamfile.
  * Calls to open won't wrap the new SF (assumes it needs to be closed).
  * Can be used in metas to test custom IO without closing the external SF. */
@@ -113,6 +178,24 @@ STREAMFILE* open_clamp_streamfile_f(STREAMFILE *streamfile, off_t start, size_t
 STREAMFILE* open_io_streamfile(STREAMFILE *streamfile, void *data, size_t data_size, void *read_callback, void *size_callback);
 STREAMFILE* open_io_streamfile_f(STREAMFILE *streamfile, void *data, size_t data_size, void *read_callback, void *size_callback);
 
+/* Decryption done by a decrypt STREAMFILE to data in the start~end range, with ops in this order. */
+typedef struct {
+    off_t start;            /* first encrypted offset */
+    off_t end;              /* encrypted data end (0 = up to EOF) */
+    int reverse_bits_pre;   /* reverse bits of each byte before XOR */
+    const uint8_t *key;     /* XOR key, repeated from start (copied on open) */
+    size_t key_size;
+    size_t key_start;       /* key position at start */
+    int reverse_bits_post;  /* reverse bits of each byte after XOR */
+    int nibble_swap;        /* swap nibbles of each byte after XOR */
+} decrypt_streamfile_config;
+
+/* Opens a STREAMFILE that decrypts data with simple byte ops (XOR with a repeated key, bit reversal,
+ * nibble swap), done over whole buffers that are kept for later reads, so decrypted data costs about the
+ * same as plain reads. Can be used by metas instead of custom IO (multiple ranges can be chained). */
+STREAMFILE* open_decrypt_streamfile(STREAMFILE *streamfile, const decrypt_streamfile_config *cfg);
+STREAMFILE* open_decrypt_streamfile_f(STREAMFILE *streamfile, const decrypt_streamfile_config *cfg);
+
 /* Opens a STREAMFILE that reports a fake name, but still re-opens itself properly.
  * Can be used to trick a meta's extension check (to call from another, with a modified SF).
  * When fakename isn't supplied it's read from the streamfile, and the extension swapped with fakeext.
@@ -103,7 +103,14 @@ void put_32bitBE(uint8_t * buf, int32_t i) {
 void swap_samples_le(sample_t *buf, int count) {
     /* Windows can't be BE... I think */
 #if !defined(_WIN32)
-#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    int i;
+    for (i = 0; i < count; i++) {
+        /* known BE: plain 16b swap (aabb > bbaa), simple enough for compilers to vectorize */
+        uint16_t v = (uint16_t)buf[i];
+        buf[i] = (sample_t)((v << 8) | (v >> 8));
+    }
+#elif !defined(__BYTE_ORDER__) || __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
     int i;
     for (i = 0; i < count; i++) {
         /* 16b sample in memory: aabb where aa=MSB, bb=LSB */
@@ -10,8 +10,11 @@
 #include "layout/layout.h"
 #include "coding/coding.h"
 #include "mixing.h"
+#include "profiling.h"
 
 static void try_dual_file_stereo(VGMSTREAM * opened_vgmstream, STREAMFILE *streamFile, VGMSTREAM* (*init_vgmstream_function)(STREAMFILE*));
+static void load_loop_state(VGMSTREAM * vgmstream);
+static int vgmstream_open_stream_internal(VGMSTREAM * vgmstream, STREAMFILE *streamFile, off_t start_offset);
 
 
 /* list of metadata parser functions that will recognize files, used on init */
@@ -509,8 +512,18 @@ static VGMSTREAM * init_vgmstream_internal(STREAMFILE *streamFile) {
     fcns_size = (sizeof(init_vgmstream_functions)/sizeof(init_vgmstream_functions[0]));
     /* try a series of formats, see which works */
     for (i = 0; i < fcns_size; i++) {
+        VGMSTREAM * vgmstream;
+#ifdef VGM_PROFILING
+        uint64_t profile_time = profile_now();
+#endif
+
         /* call init function and see if valid VGMSTREAM was returned */
-        VGMSTREAM * vgmstream = (init_vgmstream_functions[i])(streamFile);
+        if (streamFile->info_estimated)
+            *streamFile->info_estimated = 0;
+        vgmstream = (init_vgmstream_functions[i])(streamFile);
+#ifdef VGM_PROFILING
+        profile_add_init(i, profile_time, vgmstream == NULL);
+#endif
         if (!vgmstream)
             continue;
 
@@ -595,6 +608,8 @@ static VGMSTREAM * init_vgmstream_internal(STREAMFILE *streamFile) {
         if (vgmstream->stream_index == 0) {
             vgmstream->stream_index = streamFile->stream_index;
         }
+        if (streamFile->info_estimated)
+            vgmstream->samples_estimated = *streamFile->info_estimated;
 
 
         setup_vgmstream(vgmstream); /* final setup */
@@ -606,8 +621,60 @@ static VGMSTREAM * init_vgmstream_internal(STREAMFILE *streamFile) {
     return NULL;
 }
 
+/* layouts rendered by render_vgmstream_blocked */
+static int is_layout_blocked(layout_t layout_type) {
+    switch (layout_type) {
+        case layout_blocked_mxch:
+        case layout_blocked_ast:
+        case layout_blocked_halpst:
+        case layout_blocked_xa:
+        case layout_blocked_ea_schl:
+        case layout_blocked_ea_1snh:
+        case layout_blocked_caf:
+        case layout_blocked_wsi:
+        case layout_blocked_str_snds:
+        case layout_blocked_ws_aud:
+        case layout_blocked_matx:
+        case layout_blocked_dec:
+        case layout_blocked_vs:
+        case layout_blocked_mul:
+        case layout_blocked_gsb:
+        case layout_blocked_xvas:
+        case layout_blocked_thp:
+        case layout_blocked_filp:
+        case layout_blocked_ivaud:
+        case layout_blocked_ea_swvr:
+        case layout_blocked_adm:
+        case layout_blocked_bdsp:
+        case layout_blocked_tra:
+        case layout_blocked_ps2_iab:
+        case layout_blocked_vs_str:
+        case layout_blocked_rws:
+        case layout_blocked_hwas:
+        case layout_blocked_ea_sns:
+        case layout_blocked_awc:
+        case layout_blocked_vgs:
+        case layout_blocked_vawx:
+        case layout_blocked_xvag_subsong:
+        case layout_blocked_ea_wve_au00:
+        case layout_blocked_ea_wve_ad10:
+        case layout_blocked_sthd:
+        case layout_blocked_h4m:
+        case layout_blocked_xa_aiff:
+        case layout_blocked_vs_square:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
 void setup_vgmstream(VGMSTREAM * vgmstream) {
 
+    /* blocked layouts can find their loop start cheaply, so players may jump there on seeks */
+    if (is_layout_blocked(vgmstream->layout_type)) {
+        setup_loop_blocked(vgmstream);
+    }
+
     /* save start things so we can restart when seeking */
     memcpy(vgmstream->start_ch, vgmstream->ch, sizeof(VGMSTREAMCHANNEL)*vgmstream->channels);
     memcpy(vgmstream->start_vgmstream, vgmstream, sizeof(VGMSTREAM));
@@ -629,7 +696,29 @@ VGMSTREAM * init_vgmstream(const char * const filename) {
 }
 
 VGMSTREAM * init_vgmstream_from_STREAMFILE(STREAMFILE *streamFile) {
-    return init_vgmstream_internal(streamFile);
+    VGMSTREAM * vgmstream;
+    int prev_estimated;
+#ifdef VGM_PROFILING
+    uint64_t profile_time = profile_now();
+#endif
+
+    if (!streamFile)
+        return NULL;
+
+    /* info_only scanners flag estimated values in the opened file (wrappers already point to their
+     * original file's flag), and nested inits (subfiles) keep the outer init's flag */
+    if (!streamFile->info_estimated)
+        streamFile->info_estimated = &streamFile->info_estimated_flag;
+    prev_estimated = *streamFile->info_estimated;
+
+    vgmstream = init_vgmstream_internal(streamFile);
+
+    *streamFile->info_estimated = prev_estimated || (vgmstream && vgmstream->samples_estimated);
+
+#ifdef VGM_PROFILING
+    profile_add_detection(profile_time, vgmstream == NULL);
+#endif
+    return vgmstream;
 }
 
 /* Reset a VGMSTREAM to its state at the start of playback (when a plugin seeks back to zero). */
@@ -736,6 +825,8 @@ void reset_vgmstream(VGMSTREAM * vgmstream) {
         reset_layout_layered(vgmstream->layout_data);
     }
 
+    mixing_reset(vgmstream);
+
     /* note that this does not reset the constituent STREAMFILES
      * (vgmstream->ch[N].streamfiles' internal state, though shouldn't matter) */
 }
@@ -765,24 +856,29 @@ VGMSTREAM * allocate_vgmstream(int channel_count, int loop_flag) {
      *
      * This is all a bit too brittle, so code alloc'ing or changing anything sensitive should
      * take care clones are properly synced.
+     *
+     * To cut allocations (layouts may create hundreds of sub-VGMSTREAMs) the fixed-size parts
+     * share two blocks, freed through their first element only:
+     * - [vgmstream][start_vgmstream]
+     * - [ch * channels][start_ch * channels][loop_ch * channels] (loop_ch part reserved
+     *   even if not looping, and only pointed to when needed)
      */
 
     /* create vgmstream + main structs (other data is 0'ed) */
-    vgmstream = calloc(1,sizeof(VGMSTREAM));
+    vgmstream = calloc(2,sizeof(VGMSTREAM));
     if (!vgmstream) return NULL;
-    
-    vgmstream->start_vgmstream = calloc(1,sizeof(VGMSTREAM));
-    if (!vgmstream->start_vgmstream) goto fail;
+#ifdef VGM_PROFILING
+    profile_add_alloc(2*sizeof(VGMSTREAM) + 3*channel_count*sizeof(VGMSTREAMCHANNEL));
+#endif
 
-    vgmstream->ch = calloc(channel_count,sizeof(VGMSTREAMCHANNEL));
-    if (!vgmstream->ch) goto fail;
+    vgmstream->start_vgmstream = &vgmstream[1];
 
-    vgmstream->start_ch = calloc(channel_count,sizeof(VGMSTREAMCHANNEL));
-    if (!vgmstream->start_ch) goto fail;
+    vgmstream->ch = calloc(channel_count * 3,sizeof(VGMSTREAMCHANNEL));
+    if (!vgmstream->ch) goto fail;
 
+    vgmstream->start_ch = &vgmstream->ch[channel_count * 1];
     if (loop_flag) {
-        vgmstream->loop_ch = calloc(channel_count,sizeof(VGMSTREAMCHANNEL));
-        if (!vgmstream->loop_ch) goto fail;
+        vgmstream->loop_ch = &vgmstream->ch[channel_count * 2];
     }
 
     vgmstream->channels = channel_count;
@@ -796,14 +892,36 @@ fail:
     if (vgmstream) {
         mixing_close(vgmstream);
         free(vgmstream->ch);
-        free(vgmstream->start_ch);
-        free(vgmstream->loop_ch);
-        free(vgmstream->start_vgmstream);
     }
     free(vgmstream);
     return NULL;
 }
 
+int32_t seek_vgmstream(VGMSTREAM * vgmstream, int32_t seek_sample) {
+    int32_t loop_samples;
+    int loops;
+
+    reset_vgmstream(vgmstream);
+
+    /* jump to the start of the loop we want and let the caller decode the rest (codecs that keep
+     * history across blocks may differ slightly from a full decode for the first few samples) */
+    if (!vgmstream->loop_flag || !vgmstream->loop_ctx_ready || mixing_is_resampling(vgmstream))
+        return seek_sample;
+    if (seek_sample <= vgmstream->loop_start_sample)
+        return seek_sample;
+
+    loop_samples = vgmstream->loop_end_sample - vgmstream->loop_start_sample;
+    loops = (seek_sample - vgmstream->loop_start_sample) / loop_samples;
+    if (vgmstream->loop_target && loops >= vgmstream->loop_target)
+        loops = vgmstream->loop_target - 1; /* rest is decoded past the last loop end */
+
+    load_loop_state(vgmstream);
+    vgmstream->hit_loop = 1;
+    vgmstream->loop_count = loops;
+
+    return seek_sample - vgmstream->loop_start_sample - loops * loop_samples;
+}
+
 void close_vgmstream(VGMSTREAM * vgmstream) {
     if (!vgmstream)
         return;
@@ -944,11 +1062,8 @@ void close_vgmstream(VGMSTREAM * vgmstream) {
     }
 
     mixing_close(vgmstream);
-    free(vgmstream->ch);
-    free(vgmstream->start_ch);
-    free(vgmstream->loop_ch);
-    free(vgmstream->start_vgmstream);
-    free(vgmstream);
+    free(vgmstream->ch); /* also start_ch/loop_ch */
+    free(vgmstream); /* also start_vgmstream */
 }
 
 /* calculate samples based on player's config */
@@ -979,12 +1094,13 @@ void vgmstream_force_loop(VGMSTREAM* vgmstream, int loop_flag, int loop_start_sa
 
     /* this requires a bit more messing with the VGMSTREAM than I'm comfortable with... */
     if (loop_flag && !vgmstream->loop_flag && !vgmstream->loop_ch) {
-        vgmstream->loop_ch = calloc(vgmstream->channels,sizeof(VGMSTREAMCHANNEL));
-        if (!vgmstream->loop_ch) loop_flag = 0; /* ??? */
+        /* reserved on allocation after start_ch (ch + start_ch + loop_ch), use the allocated
+         * stride as vgmstream->channels may have been changed since */
+        vgmstream->loop_ch = vgmstream->start_ch + (vgmstream->start_ch - vgmstream->ch);
+        memset(vgmstream->loop_ch, 0, sizeof(VGMSTREAMCHANNEL) * vgmstream->channels);
     }
     else if (!loop_flag && vgmstream->loop_flag) {
-        free(vgmstream->loop_ch); /* not important though */
-        vgmstream->loop_ch = NULL;
+        vgmstream->loop_ch = NULL; /* not important though */
     }
 
     vgmstream->loop_flag = loop_flag;
@@ -1033,9 +1149,230 @@ void vgmstream_set_loop_target(VGMSTREAM* vgmstream, int loop_target) {
     setup_vgmstream(vgmstream);
 }
 
+void vgmstream_set_segment_prefetch(VGMSTREAM* vgmstream, int enable) {
+    int i;
+
+    if (!vgmstream) return;
+
+    if (vgmstream->layout_type == layout_segmented) {
+        segmented_layout_data *data = vgmstream->layout_data;
+        if (!prefetch_layout_segmented(data, enable)) {
+            VGM_LOG("VGMSTREAM: can't set segment prefetch\n");
+        }
+        for (i = 0; i < data->segment_count; i++) {
+            vgmstream_set_segment_prefetch(data->segments[i], enable);
+        }
+    }
+
+    if (vgmstream->layout_type == layout_layered) {
+        layered_layout_data *data = vgmstream->layout_data;
+        for (i = 0; i < data->layer_count; i++) {
+            vgmstream_set_segment_prefetch(data->layers[i], enable);
+        }
+    }
+}
+
+void vgmstream_get_segment_stats(VGMSTREAM* vgmstream, int* transitions, int* transitions_prefetched) {
+    int i, sub_transitions, sub_prefetched;
+
+    *transitions = 0;
+    *transitions_prefetched = 0;
+    if (!vgmstream) return;
+
+    if (vgmstream->layout_type == layout_segmented) {
+        segmented_layout_data *data = vgmstream->layout_data;
+        *transitions += data->transitions;
+        *transitions_prefetched += data->transitions_prefetched;
+
+        for (i = 0; i < data->segment_count; i++) {
+            /* repeated segments are counted multiple times but no matter */
+            vgmstream_get_segment_stats(data->segments[i], &sub_transitions, &sub_prefetched);
+            *transitions += sub_transitions;
+            *transitions_prefetched += sub_prefetched;
+        }
+    }
+
+    if (vgmstream->layout_type == layout_layered) {
+        layered_layout_data *data = vgmstream->layout_data;
+        for (i = 0; i < data->layer_count; i++) {
+            vgmstream_get_segment_stats(data->layers[i], &sub_transitions, &sub_prefetched);
+            *transitions += sub_transitions;
+            *transitions_prefetched += sub_prefetched;
+        }
+    }
+}
+
+int32_t vgmstream_get_range_alignment(VGMSTREAM* vgmstream) {
+    int frame_size, samples_per_frame, samples_per_block;
+
+    if (!vgmstream || vgmstream->codec_data || vgmstream->layout_data)
+        return 0;
+
+    /* frames are decoded from their position alone (MS/Xbox IMA reset history with block headers) */
+    switch(vgmstream->coding_type) {
+        case coding_PCM16LE:
+        case coding_PCM16BE:
+        case coding_PCM16_int:
+        case coding_PCM8:
+        case coding_PCM8_int:
+        case coding_PCM8_U:
+        case coding_PCM8_U_int:
+        case coding_PCM8_SB:
+        case coding_ULAW:
+        case coding_ULAW_int:
+        case coding_ALAW:
+        case coding_PCMFLOAT:
+        case coding_MSADPCM:
+        case coding_MSADPCM_int:
+        case coding_MSADPCM_ck:
+        case coding_XBOX_IMA:
+        case coding_XBOX_IMA_int:
+        case coding_MS_IMA:
+            break;
+        default:
+            return 0;
+    }
+
+    frame_size = get_vgmstream_frame_size(vgmstream);
+    samples_per_frame = get_vgmstream_samples_per_frame(vgmstream);
+    if (samples_per_frame <= 0)
+        return 0;
+
+    switch(vgmstream->layout_type) {
+        case layout_none:
+            return samples_per_frame;
+
+        case layout_interleave:
+            if (vgmstream->interleave_first_block_size)
+                return 0;
+            if (vgmstream->interleave_last_block_size && vgmstream->channels > 1)
+                return 0;
+            if (vgmstream->coding_type == coding_MS_IMA)
+                return 0;
+            if (vgmstream_is_sample_interleaved(vgmstream))
+                return samples_per_frame; /* behaves like flat */
+            if (frame_size <= 0)
+                return 0;
+
+            samples_per_block = vgmstream->interleave_block_size / frame_size * samples_per_frame;
+            if (samples_per_block == 0 && vgmstream->channels == 1)
+                return samples_per_frame; /* same */
+            return samples_per_block;
+
+        default:
+            return 0;
+    }
+}
+
+VGMSTREAM* vgmstream_open_range(VGMSTREAM* vgmstream, int32_t start_sample) {
+    VGMSTREAM* range = NULL;
+    int32_t alignment;
+    int ch, j;
+
+    alignment = vgmstream_get_range_alignment(vgmstream);
+    if (alignment <= 0 || start_sample < 0 || start_sample > vgmstream->num_samples || start_sample % alignment)
+        goto fail;
+    if (mixing_is_resampling(vgmstream))
+        goto fail; /* resampler state can't be split */
+
+    range = allocate_vgmstream(vgmstream->channels, 0);
+    if (!range) goto fail;
+
+    /* copy the start state but keep the copy's own allocs */
+    {
+        VGMSTREAMCHANNEL* range_ch = range->ch;
+        void* range_start = range->start_vgmstream;
+        void* range_mixing = range->mixing_data;
+
+        memcpy(range, vgmstream->start_vgmstream, sizeof(VGMSTREAM));
+        memcpy(range_ch, vgmstream->start_ch, sizeof(VGMSTREAMCHANNEL) * vgmstream->channels);
+        for (ch = 0; ch < range->channels; ch++) {
+            range_ch[ch].streamfile = NULL;
+        }
+
+        range->ch = range_ch;
+        range->start_ch = &range_ch[range->channels];
+        range->loop_ch = NULL;
+        range->start_vgmstream = range_start;
+        range->mixing_data = range_mixing;
+        range->loop_flag = 0;
+        range->hit_loop = 0;
+        range->loop_ctx_ready = 0;
+    }
+
+    mixing_copy(range, vgmstream);
+
+    /* reopen files (shared between channels the same way) so copies don't share buffers */
+    for (ch = 0; ch < range->channels; ch++) {
+        STREAMFILE* sf = vgmstream->start_ch[ch].streamfile;
+        char filename[PATH_LIMIT];
+
+        if (!sf) goto fail;
+        for (j = 0; j < ch; j++) {
+            if (vgmstream->start_ch[j].streamfile == sf) {
+                range->ch[ch].streamfile = range->ch[j].streamfile;
+                break;
+            }
+        }
+        if (range->ch[ch].streamfile)
+            continue;
+
+        get_streamfile_name(sf, filename, sizeof(filename));
+        range->ch[ch].streamfile = open_streamfile(sf, filename);
+        if (!range->ch[ch].streamfile) goto fail;
+    }
+
+    /* position like the layout would when reaching start_sample (flat layouts just pass the position to decoders) */
+    if (vgmstream->layout_type == layout_interleave && !vgmstream_is_sample_interleaved(vgmstream)
+            && vgmstream->interleave_block_size >= get_vgmstream_frame_size(vgmstream)) {
+        off_t skip = (start_sample / alignment) * vgmstream->interleave_block_size * vgmstream->channels;
+        for (ch = 0; ch < range->channels; ch++) {
+            range->ch[ch].offset += skip;
+        }
+        range->samples_into_block = 0;
+    }
+    else {
+        if (vgmstream->coding_type == coding_MS_IMA) { /* decoder moves offsets per block */
+            off_t skip = (start_sample / alignment) * vgmstream->interleave_block_size;
+            for (ch = 0; ch < range->channels; ch++) {
+                range->ch[ch].offset += skip;
+            }
+        }
+        range->samples_into_block = start_sample;
+    }
+    range->current_sample = start_sample;
+
+    setup_vgmstream(range);
+    return range;
+
+fail:
+    close_vgmstream(range);
+    return NULL;
+}
+
 
 /* Decode data into sample buffer */
 void render_vgmstream(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream) {
+    /* the resampler calls render_vgmstream_internal as needed */
+    if (mixing_is_resampling(vgmstream)) {
+#ifdef VGM_PROFILING
+        uint64_t profile_time = profile_now();
+        resample_vgmstream(buffer, sample_count, vgmstream);
+        profile_add_resampling(profile_time, sample_count);
+#else
+        resample_vgmstream(buffer, sample_count, vgmstream);
+#endif
+        return;
+    }
+
+    render_vgmstream_internal(buffer, sample_count, vgmstream);
+}
+
+void render_vgmstream_internal(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream) {
+#ifdef VGM_PROFILING
+    uint64_t profile_time = profile_now();
+#endif
+
     switch (vgmstream->layout_type) {
         case layout_interleave:
             render_vgmstream_interleave(buffer,sample_count,vgmstream);
@@ -1093,6 +1430,10 @@ void render_vgmstream(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmst
             break;
     }
 
+#ifdef VGM_PROFILING
+    profile_add_render(vgmstream->layout_type, profile_time, sample_count);
+#endif
+
     mix_vgmstream(buffer, sample_count, vgmstream);
 }
 
@@ -1489,10 +1830,57 @@ int get_vgmstream_shortframe_size(VGMSTREAM * vgmstream) {
     }
 }
 
+/* _int codecs' channels normally point to consecutive samples in the same file (set by blocked layouts) */
+static int is_channel_interleaved(VGMSTREAM * vgmstream, int sample_size) {
+    int ch;
+
+    for (ch = 1; ch < vgmstream->channels; ch++) {
+        if (vgmstream->ch[ch].streamfile != vgmstream->ch[0].streamfile ||
+                vgmstream->ch[ch].offset != vgmstream->ch[0].offset + ch * sample_size)
+            return 0;
+    }
+    return 1;
+}
+
+/* PCM with one sample per interleave is just sample-interleaved data, that the interleave layout
+ * renders as a single block so all channels can be decoded at once (if channels do point to
+ * consecutive samples, as metas may set their own streamfiles/offsets per channel) */
+int vgmstream_is_sample_interleaved(VGMSTREAM * vgmstream) {
+    int sample_size;
+
+    if (vgmstream->layout_type != layout_interleave || vgmstream->channels <= 1)
+        return 0;
+    if (vgmstream->interleave_first_block_size || vgmstream->interleave_last_block_size)
+        return 0;
+
+    switch (vgmstream->coding_type) {
+        case coding_PCM16LE:
+        case coding_PCM16BE:
+            sample_size = 0x02;
+            break;
+        case coding_PCM8:
+        case coding_PCM8_U:
+            sample_size = 0x01;
+            break;
+        case coding_PCMFLOAT:
+            sample_size = 0x04;
+            break;
+        default:
+            return 0;
+    }
+
+    if (vgmstream->interleave_block_size != sample_size)
+        return 0;
+    return is_channel_interleaved(vgmstream, sample_size);
+}
+
 /* Decode samples into the buffer. Assume that we have written samples_written into the
  * buffer already, and we have samples_to_do consecutive samples ahead of us. */
 void decode_vgmstream(VGMSTREAM * vgmstream, int samples_written, int samples_to_do, sample_t * buffer) {
     int ch;
+#ifdef VGM_PROFILING
+    uint64_t profile_time = profile_now();
+#endif
 
     switch (vgmstream->coding_type) {
         case coding_CRI_ADX:
@@ -1521,18 +1909,34 @@ void decode_vgmstream(VGMSTREAM * vgmstream, int samples_written, int samples_to
             break;
 
         case coding_PCM16LE:
+            if (vgmstream_is_sample_interleaved(vgmstream)) {
+                decode_pcm16_mch(&vgmstream->ch[0],buffer+samples_written*vgmstream->channels,
+                        vgmstream->channels,vgmstream->samples_into_block,samples_to_do, 0);
+                break;
+            }
             for (ch = 0; ch < vgmstream->channels; ch++) {
                 decode_pcm16le(&vgmstream->ch[ch],buffer+samples_written*vgmstream->channels+ch,
                         vgmstream->channels,vgmstream->samples_into_block,samples_to_do);
             }
             break;
         case coding_PCM16BE:
+            if (vgmstream_is_sample_interleaved(vgmstream)) {
+                decode_pcm16_mch(&vgmstream->ch[0],buffer+samples_written*vgmstream->channels,
+                        vgmstream->channels,vgmstream->samples_into_block,samples_to_do, 1);
+                break;
+            }
             for (ch = 0; ch < vgmstream->channels; ch++) {
                 decode_pcm16be(&vgmstream->ch[ch],buffer+samples_written*vgmstream->channels+ch,
                         vgmstream->channels,vgmstream->samples_into_block,samples_to_do);
             }
             break;
         case coding_PCM16_int:
+            if (is_channel_interleaved(vgmstream, 0x02)) {
+                decode_pcm16_mch(&vgmstream->ch[0],buffer+samples_written*vgmstream->channels,
+                        vgmstream->channels,vgmstream->samples_into_block,samples_to_do,
+                        vgmstream->codec_endian);
+                break;
+            }
             for (ch = 0; ch < vgmstream->channels; ch++) {
                 decode_pcm16_int(&vgmstream->ch[ch],buffer+samples_written*vgmstream->channels+ch,
                         vgmstream->channels,vgmstream->samples_into_block,samples_to_do,
@@ -1540,24 +1944,44 @@ void decode_vgmstream(VGMSTREAM * vgmstream, int samples_written, int samples_to
             }
             break;
         case coding_PCM8:
+            if (vgmstream_is_sample_interleaved(vgmstream)) {
+                decode_pcm8_mch(&vgmstream->ch[0],buffer+samples_written*vgmstream->channels,
+                        vgmstream->channels,vgmstream->samples_into_block,samples_to_do, 0);
+                break;
+            }
             for (ch = 0; ch < vgmstream->channels; ch++) {
                 decode_pcm8(&vgmstream->ch[ch],buffer+samples_written*vgmstream->channels+ch,
                         vgmstream->channels,vgmstream->samples_into_block,samples_to_do);
             }
             break;
         case coding_PCM8_int:
+            if (is_channel_interleaved(vgmstream, 0x01)) {
+                decode_pcm8_mch(&vgmstream->ch[0],buffer+samples_written*vgmstream->channels,
+                        vgmstream->channels,vgmstream->samples_into_block,samples_to_do, 0);
+                break;
+            }
             for (ch = 0; ch < vgmstream->channels; ch++) {
                 decode_pcm8_int(&vgmstream->ch[ch],buffer+samples_written*vgmstream->channels+ch,
                         vgmstream->channels,vgmstream->samples_into_block,samples_to_do);
             }
             break;
         case coding_PCM8_U:
+            if (vgmstream_is_sample_interleaved(vgmstream)) {
+                decode_pcm8_mch(&vgmstream->ch[0],buffer+samples_written*vgmstream->channels,
+                        vgmstream->channels,vgmstream->samples_into_block,samples_to_do, 1);
+                break;
+            }
             for (ch = 0; ch < vgmstream->channels; ch++) {
                 decode_pcm8_unsigned(&vgmstream->ch[ch],buffer+samples_written*vgmstream->channels+ch,
                         vgmstream->channels,vgmstream->samples_into_block,samples_to_do);
             }
             break;
         case coding_PCM8_U_int:
+            if (is_channel_interleaved(vgmstream, 0x01)) {
+                decode_pcm8_mch(&vgmstream->ch[0],buffer+samples_written*vgmstream->channels,
+                        vgmstream->channels,vgmstream->samples_into_block,samples_to_do, 1);
+                break;
+            }
             for (ch = 0; ch < vgmstream->channels; ch++) {
                 decode_pcm8_unsigned_int(&vgmstream->ch[ch],buffer+samples_written*vgmstream->channels+ch,
                         vgmstream->channels,vgmstream->samples_into_block,samples_to_do);
@@ -1601,6 +2025,12 @@ void decode_vgmstream(VGMSTREAM * vgmstream, int samples_written, int samples_to
             }
             break;
         case coding_PCMFLOAT:
+            if (vgmstream_is_sample_interleaved(vgmstream)) {
+                decode_pcmfloat_mch(&vgmstream->ch[0],buffer+samples_written*vgmstream->channels,
+                        vgmstream->channels,vgmstream->samples_into_block,samples_to_do,
+                        vgmstream->codec_endian);
+                break;
+            }
             for (ch = 0; ch < vgmstream->channels; ch++) {
                 decode_pcmfloat(&vgmstream->ch[ch],buffer+samples_written*vgmstream->channels+ch,
                         vgmstream->channels,vgmstream->samples_into_block,samples_to_do,
@@ -2121,6 +2551,10 @@ void decode_vgmstream(VGMSTREAM * vgmstream, int samples_written, int samples_to
         default:
             break;
     }
+
+#ifdef VGM_PROFILING
+    profile_add_decode(vgmstream->coding_type, profile_time, samples_to_do);
+#endif
 }
 
 /* Calculate number of consecutive samples to do (taking into account stopping for loop start and end) */
@@ -2156,6 +2590,16 @@ int vgmstream_samples_to_do(int samples_this_block, int samples_per_frame, VGMST
 }
 
 /* Detect loop start and save values, or detect loop end and restore (loop back). Returns 1 if loop was done. */
+static void load_loop_state(VGMSTREAM * vgmstream) {
+    memcpy(vgmstream->ch, vgmstream->loop_ch, sizeof(VGMSTREAMCHANNEL)*vgmstream->channels);
+    vgmstream->current_sample = vgmstream->loop_sample;
+    vgmstream->samples_into_block = vgmstream->loop_samples_into_block;
+    vgmstream->current_block_size = vgmstream->loop_block_size;
+    vgmstream->current_block_samples = vgmstream->loop_block_samples;
+    vgmstream->current_block_offset = vgmstream->loop_block_offset;
+    vgmstream->next_block_offset = vgmstream->loop_next_block_offset;
+}
+
 int vgmstream_do_loop(VGMSTREAM * vgmstream) {
     /*if (!vgmstream->loop_flag) return 0;*/
 
@@ -2258,13 +2702,7 @@ int vgmstream_do_loop(VGMSTREAM * vgmstream) {
         }
 
         /* restore! */
-        memcpy(vgmstream->ch, vgmstream->loop_ch, sizeof(VGMSTREAMCHANNEL)*vgmstream->channels);
-        vgmstream->current_sample = vgmstream->loop_sample;
-        vgmstream->samples_into_block = vgmstream->loop_samples_into_block;
-        vgmstream->current_block_size = vgmstream->loop_block_size;
-        vgmstream->current_block_samples = vgmstream->loop_block_samples;
-        vgmstream->current_block_offset = vgmstream->loop_block_offset;
-        vgmstream->next_block_offset = vgmstream->loop_next_block_offset;
+        load_loop_state(vgmstream);
 
         return 1; /* looped */
     }
@@ -2365,7 +2803,8 @@ void describe_vgmstream(VGMSTREAM * vgmstream, char * desc, int length) {
     seconds = (double)vgmstream->num_samples / vgmstream->sample_rate;
     time_mm = (int)(seconds / 60.0);
     time_ss = seconds - time_mm * 60.0;
-    snprintf(temp,TEMPSIZE, "stream total samples: %d (%1.0f:%06.3f seconds)\n", vgmstream->num_samples, time_mm, time_ss);
+    snprintf(temp,TEMPSIZE, "stream total samples: %d (%1.0f:%06.3f seconds)%s\n", vgmstream->num_samples, time_mm, time_ss,
+            vgmstream->samples_estimated ? " (may be estimated)" : "");
     concatn(length,desc,temp);
 
     snprintf(temp,TEMPSIZE, "encoding: ");
@@ -2556,56 +2995,30 @@ static void try_dual_file_stereo(VGMSTREAM * opened_vgmstream, STREAMFILE *strea
     /* We seem to have a usable, matching file. Merge in the second channel. */
     {
         VGMSTREAMCHANNEL * new_chans;
-        VGMSTREAMCHANNEL * new_loop_chans = NULL;
-        VGMSTREAMCHANNEL * new_start_chans = NULL;
 
-        /* build the channels */
-        new_chans = calloc(2,sizeof(VGMSTREAMCHANNEL));
+        /* build the channels (same layout as allocate_vgmstream: ch + start_ch + loop_ch) */
+        new_chans = calloc(2 * 3,sizeof(VGMSTREAMCHANNEL));
         if (!new_chans) goto fail;
 
         memcpy(&new_chans[dfs_pair],&opened_vgmstream->ch[0],sizeof(VGMSTREAMCHANNEL));
         memcpy(&new_chans[dfs_pair^1],&new_vgmstream->ch[0],sizeof(VGMSTREAMCHANNEL));
 
-        /* loop and start will be initialized later, we just need to allocate them here */
-        new_start_chans = calloc(2,sizeof(VGMSTREAMCHANNEL));
-        if (!new_start_chans) {
-            free(new_chans);
-            goto fail;
-        }
-
-        if (opened_vgmstream->loop_ch) {
-            new_loop_chans = calloc(2,sizeof(VGMSTREAMCHANNEL));
-            if (!new_loop_chans) {
-                free(new_chans);
-                free(new_start_chans);
-                goto fail;
-            }
-        }
-
         /* remove the existing structures */
         /* not using close_vgmstream as that would close the file */
         free(opened_vgmstream->ch);
         free(new_vgmstream->ch);
 
-        free(opened_vgmstream->start_ch);
-        free(new_vgmstream->start_ch);
-
-        if (opened_vgmstream->loop_ch) {
-            free(opened_vgmstream->loop_ch);
-            free(new_vgmstream->loop_ch);
-        }
-
-        /* fill in the new structures */
+        /* fill in the new structures (loop and start will be initialized later) */
         opened_vgmstream->ch = new_chans;
-        opened_vgmstream->start_ch = new_start_chans;
-        opened_vgmstream->loop_ch = new_loop_chans;
+        opened_vgmstream->start_ch = &new_chans[2 * 1];
+        if (opened_vgmstream->loop_ch)
+            opened_vgmstream->loop_ch = &new_chans[2 * 2];
 
         /* stereo! */
         opened_vgmstream->channels = 2;
 
         /* discard the second VGMSTREAM */
         mixing_close(new_vgmstream);
-        free(new_vgmstream->start_vgmstream);
         free(new_vgmstream);
 
         mixing_update_channel(opened_vgmstream); /* notify of new channel hacked-in */
@@ -2755,11 +3168,23 @@ int get_vgmstream_average_bitrate(VGMSTREAM * vgmstream) {
  * Should be called in metas before returning the VGMSTREAM.
  */
 int vgmstream_open_stream(VGMSTREAM * vgmstream, STREAMFILE *streamFile, off_t start_offset) {
+#ifdef VGM_PROFILING
+    uint64_t profile_time = profile_now();
+    int ok = vgmstream_open_stream_internal(vgmstream, streamFile, start_offset);
+    profile_add_open_stream(profile_time);
+    return ok;
+#else
+    return vgmstream_open_stream_internal(vgmstream, streamFile, start_offset);
+#endif
+}
+
+static int vgmstream_open_stream_internal(VGMSTREAM * vgmstream, STREAMFILE *streamFile, off_t start_offset) {
     STREAMFILE * file = NULL;
     char filename[PATH_LIMIT];
     int ch;
     int use_streamfile_per_channel = 0;
     int use_same_offset_per_channel = 0;
+    int use_block_streamfile = 0;
     int is_stereo_codec = 0;
 
 
@@ -2821,11 +3246,11 @@ int vgmstream_open_stream(VGMSTREAM * vgmstream, STREAMFILE *streamFile, off_t s
         use_streamfile_per_channel = 1;
     }
 
-    /* if blocked layout (implicit) use multiple streamfiles; using only one leads to
-     * lots of buffer-trashing, with all the jumping around in the block layout
-     * (this increases total of data read but still seems faster) */
-    if (vgmstream->layout_type != layout_none && vgmstream->layout_type != layout_interleave) {
-        use_streamfile_per_channel = 1;
+    /* if blocked layout share a streamfile that loads each whole block in one read (see
+     * render_vgmstream_blocked), as a regular shared buffer would be trashed by all the
+     * jumping around in the block (big interleaves still get a streamfile per channel) */
+    if (!use_streamfile_per_channel && is_layout_blocked(vgmstream->layout_type)) {
+        use_block_streamfile = 1;
     }
 
     /* for mono or codecs like IMA (XBOX, MS IMA, MS ADPCM) where channels work with the same bytes */
@@ -2850,6 +3275,8 @@ int vgmstream_open_stream(VGMSTREAM * vgmstream, STREAMFILE *streamFile, off_t s
     {
         if (!use_streamfile_per_channel) {
             file = open_streamfile(streamFile,filename);
+            if (use_block_streamfile)
+                file = open_block_streamfile_f(file);
             if (!file) goto fail;
         }
 
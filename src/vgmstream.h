@@ -838,6 +838,7 @@ typedef struct {
     int stream_index;               /* selected subsong (also 1-based) */
     size_t stream_size;             /* info to properly calculate bitrate in case of subsongs */
     char stream_name[STREAM_NAME_SIZE]; /* name of the current stream (info), if the file stores it and it's filled */
+    int samples_estimated;          /* opened with info_only: num_samples/loops may be estimated (reopen normally to play) */
 
     /* mapping config (info for plugins) */
     uint32_t channel_layout;        /* order: FL FR FC LFE BL BR FLC FRC BC SL SR etc (WAVEFORMATEX flags where FL=lowest bit set) */
@@ -870,6 +871,7 @@ typedef struct {
     size_t loop_block_size;         /* saved from current_block_size */
     int32_t loop_block_samples;      /* saved from current_block_samples */
     off_t loop_next_block_offset;   /* saved from next_block_offset */
+    int loop_ctx_ready;             /* loop_ch and loop block values precomputed on open (may jump to loop start without hitting it) */
 
     /* loop state */
     int hit_loop;                   /* have we seen the loop yet? */
@@ -1130,6 +1132,18 @@ typedef struct {
     sample_t *buffer;
     int input_channels;     /* internal buffer channels */
     int output_channels;    /* resulting channels (after mixing, if applied) */
+
+    /* next segment prepared in advance (optional) */
+    int prefetch_on;
+    int prefetch_segment;   /* segment being prepared, or -1 */
+    int32_t prefetch_skip;  /* samples to discard first (loop start) */
+    int32_t prefetch_skipped;
+    sample_t *prefetch_buffer;
+    int32_t prefetch_filled;
+    int32_t prefetch_played;
+
+    int transitions;        /* segment changes (stats) */
+    int transitions_prefetched;
 } segmented_layout_data;
 
 /* for files made of "parallel" layers, one per group of channels (using a complete sub-VGMSTREAM) */
@@ -1299,6 +1313,11 @@ VGMSTREAM * init_vgmstream_from_STREAMFILE(STREAMFILE *streamFile);
 /* reset a VGMSTREAM to start of stream */
 void reset_vgmstream(VGMSTREAM * vgmstream);
 
+/* Resets and jumps to seek_sample (in played samples, loops included) without decoding from the start
+ * if possible (blocked layouts with a precomputed loop start). Returns samples that still need to be
+ * skipped with render_vgmstream (seek_sample if the stream can't jump). */
+int32_t seek_vgmstream(VGMSTREAM * vgmstream, int32_t seek_sample);
+
 /* close an open vgmstream */
 void close_vgmstream(VGMSTREAM * vgmstream);
 
@@ -1329,6 +1348,23 @@ void vgmstream_force_loop(VGMSTREAM* vgmstream, int loop_flag, int loop_start_sa
 /* Set number of max loops to do, then play up to stream end (for songs with proper endings) */
 void vgmstream_set_loop_target(VGMSTREAM* vgmstream, int loop_target);
 
+/* Enable/disable preparing the next segment of segmented layouts a bit every render call before it's reached,
+ * so changing segments is cheaper with codecs that have costly setup (off by default). Also applies to inner layouts. */
+void vgmstream_set_segment_prefetch(VGMSTREAM* vgmstream, int enable);
+
+/* Get total segment changes and how many used a prefetched segment (segmented layouts only, including inner layouts) */
+void vgmstream_get_segment_stats(VGMSTREAM* vgmstream, int* transitions, int* transitions_prefetched);
+
+/* Returns sample alignment of ranges if vgmstream can be decoded in separate ranges (simple layouts and codecs
+ * where frames don't depend on previous ones, like PCM or MS-ADPCM), or 0 if not possible. */
+int32_t vgmstream_get_range_alignment(VGMSTREAM* vgmstream);
+
+/* Opens an independent copy of vgmstream (start state, no loops) positioned at start_sample, which must be aligned.
+ * The copy has its own files and mixes (must be enabled separately), so ranges may be decoded concurrently
+ * as long as files aren't sharing a handle pool and can be read from multiple threads (STDIO files are
+ * reopened by duplicating handles, only safe with STDIO_USE_PREAD). Returns NULL if not possible. */
+VGMSTREAM* vgmstream_open_range(VGMSTREAM* vgmstream, int32_t start_sample);
+
 /* Return 1 if vgmstream detects from the filename that said file can be used even if doesn't physically exist */
 int vgmstream_is_virtual_filename(const char* filename);
 
@@ -1349,6 +1385,11 @@ int get_vgmstream_frame_size(VGMSTREAM * vgmstream);
 /* In NDS IMA the frame size is the block size, so the last one is short */
 int get_vgmstream_samples_per_shortframe(VGMSTREAM * vgmstream);
 int get_vgmstream_shortframe_size(VGMSTREAM * vgmstream);
+/* Returns if the stream's interleave is a single sample (PCM only), decoded as a single block */
+int vgmstream_is_sample_interleaved(VGMSTREAM * vgmstream);
+
+/* Decode data into sample buffer at the original sample rate (used when resampling) */
+void render_vgmstream_internal(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream);
 
 /* Decode samples into the buffer. Assume that we have written samples_written into the
  * buffer already, and we have samples_to_do consecutive samples ahead of us. */
@@ -1369,4 +1410,8 @@ void get_vgmstream_coding_description(VGMSTREAM *vgmstream, char *out, size_t ou
 void get_vgmstream_layout_description(VGMSTREAM *vgmstream, char *out, size_t out_size);
 void get_vgmstream_meta_description(VGMSTREAM *vgmstream, char *out, size_t out_size);
 
+/* Get description of a coding/layout type, or NULL if unknown */
+const char * get_vgmstream_coding_name(coding_t coding_type);
+const char * get_vgmstream_layout_name(layout_t layout_type);
+
 #endif